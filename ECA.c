@@ -1,45 +1,109 @@
 /*
     ECA.c: Outputs to terminal a visualization of the time-space diagram of 
     any elementary cellular automata (rule 0-255).
+
+    Usage: ECA [-r radius] [-k states] [rule] [generation]
+
+    With a generation, the diagram starts from that generation of the rule on an infinite line
+    (worked out with EcaLife, so it can be far into the billions for regular rules) rather than
+    from the single cell on a line WIDTH wide.
+
+    With -r (1 to 3) or -k (2 or 3) the rule is the Wolfram code of a totalistic rule with that
+    radius and number of states instead, drawn the same way from a single cell in state 1.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "includes/cart_ca.h"
 
 #define WIDTH 80
 #define HEIGHT 128
 
 int main(int argc, char *argv[]) {
+    const char *ruleArg = NULL, *generationArg = NULL;
+    int radius = 0, states = 0;
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        if (arg[0] == '-' && !isdigit((unsigned char)arg[1])) {
+            if (arg[1] == 'h') {
+                printf("'ECA', draws the time-space diagram of an elementary cellular automaton.\nUsage: ECA [-r radius] [-k states] [rule] [generation]\n\trule: 0-255 (default: 30)\n\tgeneration: Start this many generations in, on an infinite line\n\t-r (number): Radius 1 to 3, making rule a totalistic code\n\t-k (number): States 2 or 3, making rule a totalistic code\n");
+                return 1;
+            }
+            if (arg[1] != 'r' && arg[1] != 'k') {
+                printf("Unknown flag -%c\n", arg[1]);
+                return 1;
+            }
+            if (++i == argc) {
+                printf("Flag -%c missing argument\n", arg[1]);
+                return 1;
+            }
+            if (arg[1] == 'r') radius = atoi(argv[i]);
+            else states = atoi(argv[i]);
+        } else if (!ruleArg) {
+            ruleArg = arg;
+        } else {
+            generationArg = arg;
+        }
+    }
+
     int rule = 30;
-    if (argc > 1) {
-        rule = atoi(argv[1]) % 256;
+    if (ruleArg) {
+        rule = atoi(ruleArg) % 256;
+    }
+
+    TotalisticRule totalistic;
+    int isTotalistic = radius || states;
+    if (isTotalistic) {
+        if (generationArg) {
+            printf("A generation can only be given for an elementary rule\n");
+            return 1;
+        }
+        if (totalisticRule(&totalistic, radius ? radius : 1, states ? states : 2,
+                           ruleArg ? strtoull(ruleArg, NULL, 10) : 30)) {
+            printf("Radius must be 1 to %d, states 2 to %d, and the code less than states^((2*radius+1)*(states-1)+1)\n",
+                   CA_MAX_RADIUS, CA_MAX_STATES);
+            return 1;
+        }
     }
 
-    char space = ' ';
-    char fill  = '#';
+    const char *glyphs = isTotalistic && totalistic.states == 3 ? " +#" : " #";
 
-    char bits[WIDTH+1];
-    for (int i = 0; i < WIDTH; i++) 
-        bits[i] = space;
-    bits[WIDTH/2] = fill;
-    //bits[WIDTH-1] = fill;
-    bits[WIDTH] = '\0';
+    // a margin either side, HEIGHT wide on the infinite line so its wrong edges never reach the middle
+    int margin = 0;
+    unsigned char cells[WIDTH + 2*HEIGHT] = {0};
+    if (generationArg) {
+        unsigned long long generation = strtoull(generationArg, NULL, 10);
+        unsigned char seed = 1;
+        EcaLife *life = ecaLifeNew(rule, &seed, 1);
+        if (ecaLifeAdvance(life, generation)) {
+            printf("Generation can be at most %llu\n", ECA_LIFE_MAX_GENERATIONS);
+            ecaLifeFree(life);
+            return 1;
+        }
+        margin = HEIGHT;
+        ecaLifeCells(life, -WIDTH/2 - margin, WIDTH + 2*margin, cells);
+        ecaLifeFree(life);
+    } else {
+        cells[WIDTH/2] = 1;
+    }
+    //cells[WIDTH-1] = 1;
     
     int cy = 0;
-    char nextbits[WIDTH];
+    char line[WIDTH+1];
+    unsigned char nextcells[WIDTH + 2*HEIGHT];
+    line[WIDTH] = '\0';
     while (cy < HEIGHT) {
-        printf("%s\n", bits);
         for (int i = 0; i < WIDTH; i++) {
-            int r = 0;
-            for (int j = -1; j <= 1; j++) {
-                if (i+j >= 0 && i+j < WIDTH && bits[i+j] == fill) {
-                    r += 1 << (1-j);
-                }
-            }
-            nextbits[i] = (rule >> r & 1) ? fill : space;
+            line[i] = glyphs[cells[margin + i]];
         }
-        for (int i = 0; i < WIDTH; i++) {
-            bits[i] = nextbits[i];
+        printf("%s\n", line);
+        if (isTotalistic) totalisticStep(&totalistic, cells, nextcells, WIDTH);
+        else ecaStep(rule, cells, nextcells, WIDTH + 2*margin);
+        for (int i = 0; i < WIDTH + 2*margin; i++) {
+            cells[i] = nextcells[i];
         }
         cy++;
     }
@@ -0,0 +1,373 @@
+/*
+    bench.c: microbenchmarks for libcart's hot loops.
+
+    Usage: bench [-r reps] [-l label] [name filter...]
+
+    Each benchmark is warmed up, calibrated to about 20ms a repetition, then timed over 'reps'
+    repetitions (default 10). The results go to stdout as JSON, with per-op times in ns (median,
+    min, mean and standard deviation over the repetitions) and the throughput in the benchmark's
+    own unit (samples, cells or frames) per second from the median. Progress goes to stderr.
+    Anything the kernels themselves print is sent to /dev/null. Only benchmarks whose names contain
+    one of the filters are run, if any are given.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../includes/stdperlin.h"
+#include "../includes/cart_board.h"
+#include "../includes/cart_screen.h"
+#include "../includes/cart_ca.h"
+#include "../includes/cart_maze.h"
+#include "../includes/cart_noise.h"
+
+#define TARGET_NS 20000000LL // aim for repetitions this long
+
+typedef struct {
+    const char *name;
+    const char *unit;       // what the throughput is counted in
+    double unitsPerOp;
+    void (*setup)(void);    // once, before anything is timed
+    void (*reset)(void);    // if set, untimed before every op, and ops are timed one at a time
+    void (*op)(void);
+} Bench;
+
+long long nanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+volatile float sink; // results go here so the compiler can't drop the work
+
+/* Perlin noise, sampled over a 16x16 patch that moves each op */
+#define PATCH 16
+float patchX;
+
+void perlinNoise3(void) {
+    float sum = 0;
+    for (int y = 0; y < PATCH; y++) {
+        for (int x = 0; x < PATCH; x++) {
+            sum += stb_perlin_noise3_seed(patchX + x * 0.13f, y * 0.13f, 0, 0, 0, 0, 0);
+        }
+    }
+    patchX += 0.77f;
+    sink = sum;
+}
+
+void perlinNoise2(void) {
+    float sum = 0;
+    for (int y = 0; y < PATCH; y++) {
+        for (int x = 0; x < PATCH; x++) {
+            sum += stb_perlin_noise2_seed(patchX + x * 0.13f, y * 0.13f, 0, 0, 0);
+        }
+    }
+    patchX += 0.77f;
+    sink = sum;
+}
+
+/* Tileable noise with a 100x60 period, a patch at a time and a row at a time */
+void perlinWrap(void) {
+    float sum = 0;
+    for (int y = 0; y < PATCH; y++) {
+        for (int x = 0; x < PATCH; x++) {
+            sum += stb_perlin_noise3_wrap_nonpow2(patchX + x * 0.13f, y * 0.13f, 0, 100, 60, 0, 0);
+        }
+    }
+    patchX += 0.77f;
+    sink = sum;
+}
+
+void perlinWrapRow(void) {
+    float row[PATCH], sum = 0;
+    for (int y = 0; y < PATCH; y++) {
+        stb_perlin_noise3_wrap_nonpow2_row(row, PATCH, patchX, 0.13f, y * 0.13f, 0, 100, 60, 0, 0);
+        for (int x = 0; x < PATCH; x++) sum += row[x];
+    }
+    patchX += 0.77f;
+    sink = sum;
+}
+
+void perlinFbm(int octaves) {
+    float sum = 0;
+    for (int y = 0; y < PATCH; y++) {
+        for (int x = 0; x < PATCH; x++) {
+            sum += stb_perlin_fbm_noise3(patchX + x * 0.13f, y * 0.13f, 0, 2.0f, 0.5f, octaves);
+        }
+    }
+    patchX += 0.77f;
+    sink = sum;
+}
+
+void perlinFbm1(void) { perlinFbm(1); }
+void perlinFbm6(void) { perlinFbm(6); }
+
+void perlinFbm6Deriv(void) {
+    float sum = 0, grad[3];
+    for (int y = 0; y < PATCH; y++) {
+        for (int x = 0; x < PATCH; x++) {
+            sum += stb_perlin_fbm_noise3_deriv(patchX + x * 0.13f, y * 0.13f, 0, 2.0f, 0.5f, 6, grad);
+            sum += grad[0] + grad[1] + grad[2];
+        }
+    }
+    patchX += 0.77f;
+    sink = sum;
+}
+
+/* A strip of a fine-grained grain render, adaptively and sampling everything */
+#define GRAIN_COLS 400
+#define GRAIN_ROWS 50
+GrainView grainView = { .width = GRAIN_COLS, .height = GRAIN_ROWS, .zoom = 0.002f, .invert = 1 };
+unsigned char grainIdx[GRAIN_COLS*GRAIN_ROWS];
+
+void grainOp(void) {
+    grainRows(&grainView, 0, GRAIN_ROWS, grainIdx);
+    grainView.xOffset += 0.77f;
+}
+
+void grainAdaptive(void) { grainView.exhaustive = 0; grainOp(); }
+void grainExhaustive(void) { grainView.exhaustive = 1; grainOp(); }
+
+/* One ECA generation over a wide row, ping-ponging between two buffers */
+#define ECA_WIDTH 4096
+unsigned char ecaRows[2][ECA_WIDTH];
+int ecaCur;
+
+void ecaSetup(void) {
+    ecaCur = 0;
+    srand(1);
+    for (int i = 0; i < ECA_WIDTH; i++) ecaRows[0][i] = rand() & 1;
+}
+
+void ecaOp(void) {
+    ecaStep(30, ecaRows[ecaCur], ecaRows[!ecaCur], ECA_WIDTH);
+    ecaCur = !ecaCur;
+}
+
+/* The same under a radius 2 binary and a radius 3 3-state totalistic rule */
+TotalisticRule totalistic;
+
+void r2k2Setup(void) {
+    ecaSetup();
+    totalisticRule(&totalistic, 2, 2, 52);
+}
+
+void r3k3Setup(void) {
+    ecaCur = 0;
+    srand(1);
+    for (int i = 0; i < ECA_WIDTH; i++) ecaRows[0][i] = rand() % 3;
+    totalisticRule(&totalistic, 3, 3, 1234567);
+}
+
+void totalisticOp(void) {
+    totalisticStep(&totalistic, ecaRows[ecaCur], ecaRows[!ecaCur], ECA_WIDTH);
+    ecaCur = !ecaCur;
+}
+
+/* Rule 110 from one cell to generation 2^20 with EcaLife, starting from nothing each time */
+void ecaLifeOp(void) {
+    unsigned char seed = 1;
+    EcaLife *life = ecaLifeNew(110, &seed, 1);
+    ecaLifeAdvance(life, 1 << 20);
+    ecaLifeFree(life);
+}
+
+/* Maze carving and drawing */
+#define MAZE_SIDE 128
+Maze maze;
+
+void mazeSetup(void) {
+    if (maze.tiles) freeMaze(&maze);
+    srand(1);
+    maze = createMaze(MAZE_SIDE, MAZE_SIDE);
+    bt(&maze, 0, 0, 0);
+}
+
+void mazeReset(void) {
+    for (int r = 0; r < maze.rows; r++) {
+        for (int c = 0; c < maze.cols; c++) {
+            maze.tiles[r][c].down = 1;
+            maze.tiles[r][c].right = 1;
+            maze.visited[r][c] = 0;
+        }
+    }
+    maze.numvisited = 0;
+}
+
+void mazeCarve(void) { bt(&maze, 0, 0, 0); }
+
+void mazeDraw(void) {
+    drawmaze(&maze);
+    fflush(stdout);
+}
+
+/* Minesweeper boards */
+#define BIG_SIDE 512
+MSBoard board;
+Screen screen;
+
+void createExpert(void) {
+    MSBoard msb = createBoard(30, 16, 99);
+    free(msb.cells);
+}
+
+void createBig(void) {
+    MSBoard msb = createBoard(BIG_SIDE, BIG_SIDE, BIG_SIDE * BIG_SIDE / 5);
+    free(msb.cells);
+}
+
+void floodSetup(void) {
+    free(board.cells);
+    board = allocBoard(BIG_SIDE, BIG_SIDE);
+}
+
+void floodReset(void) {
+    for (int y = 0; y < board.height; y++) {
+        for (int x = 0; x < board.width; x++) CELL(&board, x, y) &= ~CELL_REVEALED;
+    }
+    board.numRevealed = 0;
+}
+
+void floodOp(void) { revealMine(&board, 0, 0); }
+
+void drawSetup(void) {
+    // a game part way through: an opening from the middle of an expert-sized board
+    free(board.cells);
+    srand(1);
+    board = createBoard(52, 30, 320);
+    clearFirstMoveArea(&board, 26, 15);
+    revealMine(&board, 26, 15);
+}
+
+void drawFullReset(void) { freeScreen(&screen); }
+
+void drawOp(void) { drawBoard(&screen, &board, NULL); }
+
+void drawDiffOp(void) {
+    // the usual turn: one cell changes and the frame is redrawn
+    CELL(&board, 0, 0) ^= CELL_FLAGGED;
+    drawBoard(&screen, &board, NULL);
+}
+
+Bench benches[] = {
+    { "perlin_noise3",         "sample",        PATCH*PATCH,           NULL,       NULL,          perlinNoise3 },
+    { "perlin_noise2",         "sample",        PATCH*PATCH,           NULL,       NULL,          perlinNoise2 },
+    { "perlin_wrap",           "sample",        PATCH*PATCH,           NULL,       NULL,          perlinWrap },
+    { "perlin_wrap_row",       "sample",        PATCH*PATCH,           NULL,       NULL,          perlinWrapRow },
+    { "perlin_fbm_1oct",       "sample-octave", PATCH*PATCH,           NULL,       NULL,          perlinFbm1 },
+    { "perlin_fbm_6oct",       "sample-octave", PATCH*PATCH*6,         NULL,       NULL,          perlinFbm6 },
+    { "perlin_fbm_6oct_deriv", "sample-octave", PATCH*PATCH*6,         NULL,       NULL,          perlinFbm6Deriv },
+    { "grain_rows_adaptive",   "cell",          GRAIN_COLS*GRAIN_ROWS, NULL,       NULL,          grainAdaptive },
+    { "grain_rows_exhaustive", "cell",          GRAIN_COLS*GRAIN_ROWS, NULL,       NULL,          grainExhaustive },
+    { "eca_step",              "cell",          ECA_WIDTH,             ecaSetup,   NULL,          ecaOp },
+    { "totalistic_r2_k2",      "cell",          ECA_WIDTH,             r2k2Setup,  NULL,          totalisticOp },
+    { "totalistic_r3_k3",      "cell",          ECA_WIDTH,             r3k3Setup,  NULL,          totalisticOp },
+    { "eca_life_110",          "run",           1,                     NULL,       NULL,          ecaLifeOp },
+    { "maze_bt",               "cell",          MAZE_SIDE*MAZE_SIDE,   mazeSetup,  mazeReset,     mazeCarve },
+    { "maze_draw",             "cell",          MAZE_SIDE*MAZE_SIDE,   mazeSetup,  NULL,          mazeDraw },
+    { "board_create_expert",   "cell",          30*16,                 NULL,       NULL,          createExpert },
+    { "board_create_512",      "cell",          BIG_SIDE*BIG_SIDE,     NULL,       NULL,          createBig },
+    { "reveal_flood_512",      "cell",          BIG_SIDE*BIG_SIDE,     floodSetup, floodReset,    floodOp },
+    { "draw_board_full",       "cell",          52*30,                 drawSetup,  drawFullReset, drawOp },
+    { "draw_board_diff",       "frame",         1,                     drawSetup,  NULL,          drawDiffOp },
+};
+
+long long timeOps(Bench *b, long iters) {
+    // total ns for 'iters' ops, leaving out the resets
+    if (!b->reset) {
+        long long t0 = nanos();
+        for (long i = 0; i < iters; i++) b->op();
+        return nanos() - t0;
+    }
+    long long total = 0;
+    for (long i = 0; i < iters; i++) {
+        b->reset();
+        long long t0 = nanos();
+        b->op();
+        total += nanos() - t0;
+    }
+    return total;
+}
+
+int cmpDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    int reps = 10;
+    const char *label = "";
+    char **filters = malloc(sizeof(char *) * argc);
+    int numFilters = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc) reps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc) label = argv[++i];
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [-r reps] [-l label] [name filter...]\n", argv[0]);
+            return 1;
+        } else filters[numFilters++] = argv[i];
+    }
+    if (reps < 1) reps = 1;
+
+    // keep the real stdout for the report and send everything else that's printed to /dev/null
+    fflush(stdout);
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    fprintf(report, "{\n  \"label\": \"%s\",\n  \"reps\": %d,\n  \"benchmarks\": [", label, reps);
+    double *samples = malloc(sizeof(double) * reps);
+    int first = 1;
+
+    for (size_t n = 0; n < sizeof(benches) / sizeof(benches[0]); n++) {
+        Bench *b = &benches[n];
+        int wanted = numFilters == 0;
+        for (int f = 0; f < numFilters; f++) {
+            if (strstr(b->name, filters[f])) wanted = 1;
+        }
+        if (!wanted) continue;
+        fprintf(stderr, "%-22s ", b->name);
+
+        if (b->setup) b->setup();
+
+        // warm up, doubling the batch until one takes a while, then size repetitions from that
+        long iters = 1;
+        long long spent;
+        while ((spent = timeOps(b, iters)) < TARGET_NS / 4 && iters < (1L << 30)) iters *= 2;
+        iters = iters * TARGET_NS / (spent > 0 ? spent : 1);
+        if (iters < 1) iters = 1;
+
+        double sum = 0;
+        for (int r = 0; r < reps; r++) {
+            samples[r] = (double)timeOps(b, iters) / iters;
+            sum += samples[r];
+        }
+        double mean = sum / reps, var = 0;
+        for (int r = 0; r < reps; r++) var += (samples[r] - mean) * (samples[r] - mean);
+        double stddev = reps > 1 ? sqrt(var / (reps - 1)) : 0;
+        qsort(samples, reps, sizeof(double), cmpDouble);
+        double median = reps & 1 ? samples[reps/2] : (samples[reps/2 - 1] + samples[reps/2]) / 2;
+        double perSec = 1e9 * b->unitsPerOp / median;
+
+        fprintf(stderr, "%12.1f ns/op  %12.4g %s/s  (+-%.1f%%)\n", median, perSec, b->unit,
+                100 * stddev / mean);
+        fprintf(report, "%s\n    {\"name\": \"%s\", \"iters\": %ld, \"unit\": \"%s\", \"units_per_op\": %g, "
+                "\"ns_per_op\": {\"median\": %.2f, \"min\": %.2f, \"mean\": %.2f, \"stddev\": %.2f}, "
+                "\"ns_per_unit\": %.4f, \"units_per_sec\": %.0f}",
+                first ? "" : ",", b->name, iters, b->unit, b->unitsPerOp, median, samples[0], mean,
+                stddev, median / b->unitsPerOp, perSec);
+        first = 0;
+    }
+
+    fprintf(report, "\n  ]\n}\n");
+    fclose(report);
+    free(samples);
+    free(filters);
+    return 0;
+}
@@ -8,17 +8,27 @@
         -x (number): X offset
         -y (number): Y offset
         -z (number): Zoom
-        -s (number): Random seed
+        -s (number): Random seed (0 to 4294967295, or hex with 0x)
         -c (number): Output width (columns)
         -r (number): Output height (rows)
         -i : Invert colors
+        -e : Sample every point (slower, same picture; for checking the fast path)
+        -o (file): Write a .pbm (filled or not) or .pgm (greyscale) image instead, with a pixel
+                   per quadrant, so 2 columns by 2 rows per character cell
+        -t (number): Threads for -o (default: all cores)
+        -C (dir): Keep the noise in tiles in this cache directory and reuse them, for redrawing
+                  overlapping views; -x and -y are rounded to whole character cells
+        -M (number): Size limit of the -C cache in megabytes (default: 256)
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
-#define STB_PERLIN_IMPLEMENTATION
-#include "includes/stdperlin.h"
+#include "includes/cart_noise.h"
+#include "includes/cart_tilecache.h"
 
 int width = 32;
 int height = 16;
@@ -26,6 +36,11 @@ float xOffset = 0;
 float yOffset = 0;
 float zoom = 0.08;
 float invert = 1;
+int exhaustive = 0;
+char *imagePath = NULL;
+int threads = 0;
+char *cacheDir = NULL;
+long long cacheMegabytes = 256;
 int seed = 0;
 
 int parseargs(int argc, char *argv[]) {
@@ -45,15 +60,67 @@ int parseargs(int argc, char *argv[]) {
                         printf("Flag -s missing argument\n");
                         return 1;
                     } else {
-                        seed = atoi(argv[i]);
+                        // all 32 bits are used; decimal like it always was, so 010 is still seed 10
+                        int hex = argv[i][0] == '0' && (argv[i][1] == 'x' || argv[i][1] == 'X');
+                        seed = (int)strtoul(argv[i], NULL, hex ? 16 : 10);
                     }
                     break;
                 case 'i':
                     // seed flag
                     invert = -1;
                     break;
+                case 'e':
+                    // exhaustive sampling flag
+                    exhaustive = 1;
+                    break;
+                case 'o':
+                    // image output flag
+                    if (++i == argc) {
+                        printf("Flag -o missing argument\n");
+                        return 1;
+                    } else {
+                        imagePath = argv[i];
+                    }
+                    break;
+                case 'C':
+                    // tile cache flag
+                    if (++i == argc) {
+                        printf("Flag -C missing argument\n");
+                        return 1;
+                    } else {
+                        cacheDir = argv[i];
+                    }
+                    break;
+                case 'M':
+                    // tile cache size flag
+                    if (++i == argc) {
+                        printf("Flag -M missing argument\n");
+                        return 1;
+                    } else if (argv[i][0] == '-') {
+                        printf("Flag -M missing argument\n");
+                        return 1;
+                    } else {
+                        cacheMegabytes = atoll(argv[i]);
+                    }
+                    break;
+                case 't':
+                    // threads flag
+                    if (++i == argc) {
+                        printf("Flag -t missing argument\n");
+                        return 1;
+                    } else if (argv[i][0] == '-') {
+                        printf("Flag -t missing argument\n");
+                        return 1;
+                    } else {
+                        threads = atoi(argv[i]);
+                        if (threads < 1) {
+                            printf("Invalid argument to -t\n");
+                            return 1;
+                        }
+                    }
+                    break;
                 case 'h':
-                    printf("'grain', generates shape with perlin noise output to terminal using \nquadrant-block Unicode characters for finer quality.\nFlags:\n\t-x (number): X offset\n\t-y (number): Y offset\n\t-z (number): Zoom\n\t-s (number): Random seed\n\t-c (number): Output width (columns)\n\t-r (number): Output height (rows)\n\t-i : Invert colors\n");
+                    printf("'grain', generates shape with perlin noise output to terminal using \nquadrant-block Unicode characters for finer quality.\nFlags:\n\t-x (number): X offset\n\t-y (number): Y offset\n\t-z (number): Zoom\n\t-s (number): Random seed (0 to 4294967295, or hex with 0x)\n\t-c (number): Output width (columns)\n\t-r (number): Output height (rows)\n\t-i : Invert colors\n\t-e : Sample every point (slower, same picture)\n\t-o (file): Write a .pbm or .pgm image instead, 2x2 pixels per cell\n\t-t (number): Threads for -o (default: all cores)\n\t-C (dir): Cache the noise in tiles in this directory (-x and -y round to whole cells)\n\t-M (number): Size limit of the -C cache in megabytes (default: 256)\n");
                     return 1;
                 case 'x':
                     // x offset flag
@@ -130,30 +197,66 @@ int parseargs(int argc, char *argv[]) {
     return 0;
 }
 
-/* Each of these symbols has a specific set of quadrants filled in; the first 4 bits of their
-   respective indices corrosponds to whether specific one of them is filled or not */
-char *symbols[16] = {" ","▖","▘","▌","▗","▄","▚","▙","▝","▞","▀","▛","▐","▟","▜","█"};
-
 int main(int argc, char *argv[]) {
     
     if (parseargs(argc, argv)) {
         return 1;
     }
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int idx = 0;
-            if (invert*stb_perlin_noise3_seed(((float)(x - width/2)*2)*zoom + xOffset, ((float)(y - height/2)*2+1)*zoom + yOffset, 0, 0, 0, 0, seed) > 0)
-                idx += 0b0001; // Bottom left
-            if (invert*stb_perlin_noise3_seed(((float)(x - width/2)*2)*zoom + xOffset, ((float)(y - height/2)*2)*zoom + yOffset, 0, 0, 0, 0, seed) > 0)
-                idx += 0b0010; // Top left
-            if (invert*stb_perlin_noise3_seed(((float)(x - width/2)*2+1)*zoom + xOffset, ((float)(y - height/2)*2+1)*zoom + yOffset, 0, 0, 0, 0, seed) > 0)
-                idx += 0b0100; // Bottom right
-            if (invert*stb_perlin_noise3_seed(((float)(x - width/2)*2+1)*zoom + xOffset, ((float)(y - height/2)*2)*zoom + yOffset, 0, 0, 0, 0, seed) > 0)
-                idx += 0b1000; // Top right
-            printf("%s", symbols[idx]);       
+    GrainView view = {
+        .width = width,
+        .height = height,
+        .xOffset = xOffset,
+        .yOffset = yOffset,
+        .zoom = zoom,
+        .invert = invert,
+        .seed = seed,
+        .exhaustive = exhaustive
+    };
+    if (cacheDir && imagePath) {
+        printf("-C can't be used with -o\n");
+        return 1;
+    }
+    if (cacheDir) {
+        if (renderGrainCached(&view, cacheDir, cacheMegabytes << 20, stdout, NULL)) {
+            perror(cacheDir);
+            return 1;
         }
-        printf("\n");
+        return 0;
+    }
+    if (!imagePath) {
+        renderGrain(&view, stdout);
+        return 0;
     }
 
-}
\ No newline at end of file
+    const char *ext = strrchr(imagePath, '.');
+    GrainFormat format;
+    if (ext && !strcmp(ext, ".pbm")) format = GRAIN_PBM;
+    else if (ext && !strcmp(ext, ".pgm")) format = GRAIN_PGM;
+    else {
+        printf("Image file for -o must end in .pbm or .pgm\n");
+        return 1;
+    }
+    FILE *out = fopen(imagePath, "wb");
+    if (!out) {
+        perror(imagePath);
+        return 1;
+    }
+    if (threads < 1) threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = writeGrainImage(&view, out, format, threads);
+    if (fclose(out)) failed = 1;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (failed) {
+        perror(imagePath);
+        return 1;
+    }
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9;
+    double megapixels = 4.0*width*height/1e6;
+    fprintf(stderr, "%s: %dx%d pixels in %.2fs, %.1f MP/s on %d thread%s\n", imagePath, 2*width,
+            2*height, secs, megapixels/secs, threads, threads == 1 ? "" : "s");
+
+}
@@ -0,0 +1,192 @@
+/*
+    'heightmap', renders fractal Perlin noise (fBm or ridged) to a raw float32 heightmap file on
+    all cores, for other tools to mmap. The file format is described in includes/cart_heightmap.h.
+
+    Uses https://github.com/nothings/stb/blob/master/stb_perlin.h for Perlin noise.
+
+    Usage: heightmap [flags] file
+
+    Flags:
+        -c (number): Width in pixels (default: 1024)
+        -r (number): Height in pixels (default: 1024)
+        -z (number): Zoom, noise units per pixel (default: 0.005)
+        -x (number): X offset
+        -y (number): Y offset
+        -Z (number): Z coordinate of the slice through the noise
+        -R : Ridged noise instead of fBm
+        -n (number): Octaves (default: 6)
+        -l (number): Lacunarity (default: 2)
+        -g (number): Gain (default: 0.5)
+        -f (number): Ridge offset, for -R (default: 1)
+        -t (number): Threads (default: all cores)
+        -k (number): Chunk size in pixels (default: 256)
+        -T (file): Write how long each chunk took, as CSV
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "includes/cart_heightmap.h"
+
+int width = 1024;
+int height = 1024;
+float zoom = 0.005;
+float xOffset = 0;
+float yOffset = 0;
+float zSlice = 0;
+int ridge = 0;
+int octaves = 6;
+float lacunarity = 2;
+float gain = 0.5;
+float ridgeOffset = 1;
+int threads = 0;
+int chunk = 256;
+char *timingPath = NULL;
+char *path = NULL;
+
+// A positive whole number for flag -flag from argv[i], or 0 (having said why)
+int positiveArg(int argc, char *argv[], int i, char flag) {
+    if (i == argc || argv[i][0] == '-') {
+        printf("Flag -%c missing argument\n", flag);
+        return 0;
+    }
+    int n = atoi(argv[i]);
+    if (n < 1) printf("Invalid argument to -%c\n", flag);
+    return n < 1 ? 0 : n;
+}
+
+int parseargs(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        if (arg[0] != '-') {
+            path = arg;
+            continue;
+        }
+        char flag = arg[1];
+        switch (flag) {
+            case 'c':
+                if (!(width = positiveArg(argc, argv, ++i, flag))) return 1;
+                break;
+            case 'r':
+                if (!(height = positiveArg(argc, argv, ++i, flag))) return 1;
+                break;
+            case 'n':
+                if (!(octaves = positiveArg(argc, argv, ++i, flag))) return 1;
+                break;
+            case 't':
+                if (!(threads = positiveArg(argc, argv, ++i, flag))) return 1;
+                break;
+            case 'k':
+                if (!(chunk = positiveArg(argc, argv, ++i, flag))) return 1;
+                break;
+            case 'R':
+                ridge = 1;
+                break;
+            case 'z': case 'x': case 'y': case 'Z': case 'l': case 'g': case 'f': case 'T':
+                if (++i == argc) {
+                    printf("Flag -%c missing argument\n", flag);
+                    return 1;
+                }
+                if (flag == 'T') timingPath = argv[i];
+                else {
+                    float value = atof(argv[i]);
+                    if (flag == 'z') zoom = value;
+                    else if (flag == 'x') xOffset = value;
+                    else if (flag == 'y') yOffset = value;
+                    else if (flag == 'Z') zSlice = value;
+                    else if (flag == 'l') lacunarity = value;
+                    else if (flag == 'g') gain = value;
+                    else ridgeOffset = value;
+                }
+                if (flag == 'z' && zoom <= 0.0f) {
+                    printf("Invalid argument to -z\n");
+                    return 1;
+                }
+                break;
+            case 'h':
+                printf("'heightmap', renders fractal Perlin noise to a raw float32 heightmap file.\nUsage: heightmap [flags] file\nFlags:\n\t-c (number): Width in pixels (default: 1024)\n\t-r (number): Height in pixels (default: 1024)\n\t-z (number): Zoom, noise units per pixel (default: 0.005)\n\t-x (number): X offset\n\t-y (number): Y offset\n\t-Z (number): Z coordinate of the slice through the noise\n\t-R : Ridged noise instead of fBm\n\t-n (number): Octaves (default: 6)\n\t-l (number): Lacunarity (default: 2)\n\t-g (number): Gain (default: 0.5)\n\t-f (number): Ridge offset, for -R (default: 1)\n\t-t (number): Threads (default: all cores)\n\t-k (number): Chunk size in pixels (default: 256)\n\t-T (file): Write how long each chunk took, as CSV\n");
+                return 1;
+            default:
+                printf("Unknown flag -%c\n", flag);
+                return 1;
+        }
+    }
+    if (!path) {
+        printf("No output file given, see -h\n");
+        return 1;
+    }
+    return 0;
+}
+
+void showProgress(int done, int total, void *ctx) {
+    (void)ctx;
+    fprintf(stderr, "\r%s: %d/%d chunks (%d%%)", path, done, total, (int)(100LL*done/total));
+    if (done == total) fputc('\n', stderr);
+}
+
+int compareNanos(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+
+    if (parseargs(argc, argv)) {
+        return 1;
+    }
+    if (threads < 1) threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    HeightmapParams params = {
+        .width = width,
+        .height = height,
+        .kind = ridge ? HEIGHTMAP_RIDGE : HEIGHTMAP_FBM,
+        .octaves = octaves,
+        .lacunarity = lacunarity,
+        .gain = gain,
+        .offset = ridgeOffset,
+        .zoom = zoom,
+        .xOffset = xOffset,
+        .yOffset = yOffset,
+        .z = zSlice,
+        .threads = threads,
+        .chunk = chunk
+    };
+    HeightmapStats stats;
+    // only draw the progress line on a terminal
+    if (writeHeightmap(&params, path, &stats, isatty(2) ? showProgress : NULL, NULL)) {
+        perror(path);
+        return 1;
+    }
+
+    fprintf(stderr, "%s: %dx%d in %.2fs, %.1f Msamples/s on %d thread%s, heights %.3f to %.3f\n",
+            path, width, height, stats.seconds, (double)width*height/1e6/stats.seconds, stats.threads,
+            stats.threads == 1 ? "" : "s", stats.min, stats.max);
+    long long *sorted = malloc(sizeof(long long) * stats.chunks);
+    if (sorted) {
+        for (int i = 0; i < stats.chunks; i++) sorted[i] = stats.chunkNanos[i];
+        qsort(sorted, stats.chunks, sizeof(long long), compareNanos);
+        fprintf(stderr, "%s: %d chunks of %dx%d, %d stolen runs; ms per chunk: min %.2f, median %.2f, "
+                "99%% %.2f, max %.2f\n", path, stats.chunks, chunk, chunk, stats.steals, sorted[0]/1e6,
+                sorted[stats.chunks/2]/1e6, sorted[stats.chunks*99/100]/1e6, sorted[stats.chunks - 1]/1e6);
+        free(sorted);
+    }
+
+    if (timingPath) {
+        FILE *f = fopen(timingPath, "w");
+        if (!f) {
+            perror(timingPath);
+            freeHeightmapStats(&stats);
+            return 1;
+        }
+        int chunksWide = (width + chunk - 1) / chunk;
+        fprintf(f, "chunk,x,y,thread,ms\n");
+        for (int i = 0; i < stats.chunks; i++) {
+            fprintf(f, "%d,%d,%d,%d,%.3f\n", i, (i % chunksWide)*chunk, (i / chunksWide)*chunk,
+                    stats.chunkThread[i], stats.chunkNanos[i]/1e6);
+        }
+        fclose(f);
+    }
+    freeHeightmapStats(&stats);
+    return 0;
+}
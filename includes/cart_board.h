@@ -0,0 +1,65 @@
+/*
+    cart_board.h: the Minesweeper board engine shared by ms and sms (lib/board.c).
+
+    Coordinates are (x, y) = (column, row) from 0, and cell indices are row-major, y*width + x.
+    Anything that picks cells at random uses rand(), so seed it with srand() first.
+*/
+
+#ifndef CART_BOARD_H
+#define CART_BOARD_H
+
+/* Each cell is one byte: the low bits hold the number of surrounding mines and the high bits its
+   state. The board is one allocation with a ring of border cells around it; borders are marked
+   revealed so the neighbour loops never need bounds checks. */
+#define CELL_COUNT    0x0F
+#define CELL_MINE     0x10
+#define CELL_REVEALED 0x20
+#define CELL_FLAGGED  0x40
+#define CELL_BORDER   0x80
+
+typedef struct {
+    int width, height;
+    int stride; // width + 2 border columns
+    unsigned char *cells; // (height + 2) rows of stride cells
+    int mines;
+    int numRevealed;
+} MSBoard;
+
+#define CELL(msb, x, y) ((msb)->cells[((y)+1)*(msb)->stride + (x)+1])
+
+// (x,y) becomes a mine, or stops being one, with the neighbours' counts kept up to date
+void placeMine(MSBoard *msb, int x, int y);
+void removeMine(MSBoard *msb, int x, int y);
+
+// An empty board (no mines, nothing revealed); free msb.cells when done with it
+MSBoard allocBoard(int width, int height);
+
+// allocBoard() with 'mines' mines scattered uniformly at random
+MSBoard createBoard(int width, int height, int mines);
+
+// Lay msb->mines mines uniformly at random on an empty board
+void scatterMines(MSBoard *msb);
+
+// Move any mines out of the 3x3 area around (x,y) to random free cells, keeping (x,y) clear
+void clearFirstMoveArea(MSBoard *msb, int x, int y);
+
+// Lay msb->mines mines on an empty board so it can be cleared from (x,y) without guessing
+void placeNoGuessMines(MSBoard *msb, int x, int y, int threads);
+
+// Reveal (x,y), flood-filling out from it if it's a 0. Returns 1 if it was a mine
+int revealMine(MSBoard *msb, int x, int y);
+
+// revealMine() for a player's move, which on the first move first lays the mines for a no-guess
+// board, and moves a mine out of the way if one was hit. Returns 1 if a mine was hit
+int makeMove(MSBoard *msb, int x, int y, int firstMove, int noGuess, int threads);
+
+// Reveal every cell, mines included (for the end of a game)
+void revealBoard(MSBoard *msb);
+
+// What a player sees, in the form mssolver.h takes: revealed counts, MS_UNKNOWN for everything else
+void boardView(MSBoard *msb, signed char *view);
+
+// The chance of a mine under each covered cell given what's showing, -1 for revealed cells
+void heatmap(MSBoard *msb, float *heat);
+
+#endif
@@ -0,0 +1,67 @@
+/*
+    cart_ca.h: the elementary cellular automaton engine behind ECA (lib/ca.c).
+
+    A row is an array of cells that are 0 or 1 (or up to states-1 for a totalistic rule); cells off
+    either end count as 0.
+
+    EcaLife runs a rule on an infinite line instead, HashLife style: the line is a binary tree of
+    segments, each distinct segment stored once, and what each segment becomes after 2^j
+    generations is worked out once and remembered. Regular rules (90, 110, 184, ...) can then be
+    run all the way to ECA_LIFE_MAX_GENERATIONS in well under a millisecond, with memory growing
+    with how varied the pattern is rather than its size. Chaotic ones (30, 45, ...) have few
+    repeats to share: rule 30 from one cell takes minutes and gigabytes to reach generation 100000
+    this way. Cells outside the starting row are 0, but rules that turn 000 into 1 are fine: the
+    background is whatever the rule makes of it.
+*/
+
+#ifndef CART_CA_H
+#define CART_CA_H
+
+#include <stddef.h>
+
+// How far an EcaLife can be run in all
+#define ECA_LIFE_MAX_GENERATIONS (1ULL << 56)
+
+// Work out the generation after 'cells' under 'rule' (0-255, Wolfram numbering) into 'next'
+void ecaStep(int rule, const unsigned char *cells, unsigned char *next, int width);
+
+#define CA_MAX_RADIUS 3
+#define CA_MAX_STATES 3
+
+/* A totalistic rule: a cell's next state depends only on the sum of the states of the cells
+   within 'radius' of it, itself included */
+typedef struct {
+    int radius, states;
+    unsigned int bits;                  // bit s is the low bit of table[s], for the 2-state kernels
+    unsigned char table[(2*CA_MAX_RADIUS + 1)*(CA_MAX_STATES - 1) + 1]; // next state by sum
+} TotalisticRule;
+
+/* Make a totalistic rule from its Wolfram code, whose base 'states' digits are the next states for
+   sums 0, 1, 2, ... from the least significant up. Radius 1 to CA_MAX_RADIUS, 2 to CA_MAX_STATES
+   states. Returns 0, or -1 if any of them is out of range. */
+int totalisticRule(TotalisticRule *rule, int radius, int states, unsigned long long code);
+
+// Like ecaStep, under a totalistic rule
+void totalisticStep(const TotalisticRule *rule, const unsigned char *cells, unsigned char *next,
+                    int width);
+
+typedef struct EcaLife EcaLife;
+
+// Start an infinite line of 0s under 'rule' with 'cells' at positions 0 to width-1
+EcaLife *ecaLifeNew(int rule, const unsigned char *cells, int width);
+
+/* Run it on by 'generations'. Returns 0, or -1 (having done nothing) if that would take it past
+   ECA_LIFE_MAX_GENERATIONS. */
+int ecaLifeAdvance(EcaLife *life, unsigned long long generations);
+
+// The cells at positions from to from+count-1 in the current generation
+void ecaLifeCells(const EcaLife *life, long long from, int count, unsigned char *out);
+
+unsigned long long ecaLifeGeneration(const EcaLife *life);
+
+// How many distinct segments it's holding, a measure of its memory use
+size_t ecaLifeNodes(const EcaLife *life);
+
+void ecaLifeFree(EcaLife *life);
+
+#endif
@@ -0,0 +1,78 @@
+/*
+    cart_heightmap.h: fractal Perlin heightmaps (lib/heightmap.c), written to a raw float32 file.
+
+    The file is a HeightmapHeader followed, at dataOffset, by width*height floats row by row, all
+    in the writer's byte order. The floats are 64-byte aligned, so a reader can mmap the file and use
+    the floats where they lie (mapHeightmap does that).
+
+    Heightmaps are rendered in square chunks by a pool of threads. Each thread starts with its own
+    run of chunks and takes them from the front; one that runs out steals the back half of another
+    thread's remaining run, so the work evens out however uneven the chunks are.
+*/
+
+#ifndef CART_HEIGHTMAP_H
+#define CART_HEIGHTMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HEIGHTMAP_MAGIC "CARTHMAP"
+#define HEIGHTMAP_VERSION 1
+
+typedef enum {
+    HEIGHTMAP_FBM,            // stb_perlin_fbm_noise3
+    HEIGHTMAP_RIDGE           // stb_perlin_ridge_noise3
+} HeightmapKind;
+
+typedef struct {
+    char magic[8];            // HEIGHTMAP_MAGIC, not terminated
+    uint32_t version;
+    uint32_t dataOffset;      // bytes from the start of the file to the first float
+    uint32_t width, height;
+    uint32_t kind;            // a HeightmapKind
+    int32_t octaves;
+    float lacunarity, gain, offset;
+    float zoom, xOffset, yOffset, z;
+    float min, max;           // of all the heights
+    char reserved[60];
+} HeightmapHeader;            // 128 bytes, the floats follow
+
+typedef struct {
+    int width, height;
+    HeightmapKind kind;
+    int octaves;
+    float lacunarity, gain;
+    float offset;             // ridge only
+    float zoom;               // noise units per pixel
+    float xOffset, yOffset, z;
+    int threads;
+    int chunk;                // side of a chunk in pixels
+} HeightmapParams;
+
+typedef struct {
+    int chunks;
+    int threads;              // workers used, no more than there are chunks
+    int steals;               // runs of chunks taken from another thread
+    double seconds;
+    long long *chunkNanos;    // how long each chunk took, in chunk order (row by row)
+    int *chunkThread;         // and which thread did it
+    float min, max;
+} HeightmapStats;
+
+/* Render a heightmap straight into a new file at path through mmap. progress, if not NULL, is
+   called from the calling thread every quarter second or so with the chunks done so far, and
+   once more at the end. stats, if not NULL, is filled in; free it with freeHeightmapStats.
+   Returns 0, or -1 with errno set if the file couldn't be made or there wasn't the memory. */
+int writeHeightmap(const HeightmapParams *params, const char *path, HeightmapStats *stats,
+                   void (*progress)(int done, int total, void *ctx), void *ctx);
+
+void freeHeightmapStats(HeightmapStats *stats);
+
+/* Map a heightmap file read-only. Returns its header, with the heights at
+   (const float *)((const char *)header + header->dataOffset), or NULL if it can't be read or
+   isn't a heightmap. *bytes is set to the mapping's size, for unmapHeightmap. */
+const HeightmapHeader *mapHeightmap(const char *path, size_t *bytes);
+
+void unmapHeightmap(const HeightmapHeader *header, size_t bytes);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+    cart_maze.h: the maze engine behind mazegen (lib/maze.c). Mazes are carved by a randomised
+    depth-first backtracker using rand(), so seed it with srand() first.
+*/
+
+#ifndef CART_MAZE_H
+#define CART_MAZE_H
+
+struct Tile {
+    short right; /* 1 = wall (blocked), 0 = empty (can pass to tile on other side) */
+    short down;
+    /* the left or upper wall can be checked by checking the left cell's right wall (or col == 0) and checking the upper cell's
+       lower wall (or row == 0) respectively */
+};
+
+typedef struct Maze {
+    int rows, cols;
+    struct Tile **tiles; // tiles[row][col]
+    short **visited;
+    int numvisited;
+    int numtiles;
+    // if set, called before every step of carving, e.g. to animate it
+    void (*onStep)(struct Maze *maze, int row, int col, int depth);
+} Maze;
+
+// A rows x cols maze with every wall up; freeMaze() it when done
+Maze createMaze(int rows, int cols);
+void freeMaze(Maze *maze);
+
+// Carve the passages, starting from (row, col)
+void bt(Maze *maze, int row, int col, int depth);
+
+// Print the maze with box-drawing characters
+void drawmaze(const Maze *maze);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+    cart_noise.h: grain's Perlin noise renderer (lib/noise.c). The noise itself is stdperlin.h, whose
+    implementation is compiled into libcart, so include that for the stb_perlin_* functions.
+
+    The picture is the sign of seeded Perlin noise, drawn with quadrant-block characters so each
+    character cell covers 2x2 samples.
+*/
+
+#ifndef CART_NOISE_H
+#define CART_NOISE_H
+
+#include <stdio.h>
+
+typedef struct {
+    int width, height;        // in character cells
+    float xOffset, yOffset;
+    float zoom;               // noise units per sample
+    float invert;             // 1, or -1 to swap filled and empty
+    int seed;
+    int exhaustive;           // sample every point instead of skipping blocks proven all one sign
+} GrainView;
+
+// Cells on a side of a grainTile
+#define GRAIN_TILE 128
+
+typedef enum {
+    GRAIN_PBM,                // 1 bit per pixel, set (black) where the sample is filled
+    GRAIN_PGM                 // 8 bit grey, 0 to 255 for the noise going from -1 to 1 (after invert)
+} GrainFormat;
+
+/* Each of these symbols has a specific set of quadrants filled in; the first 4 bits of their
+   respective indices corrosponds to whether specific one of them is filled or not */
+extern char *grainSymbols[16];
+
+// Which quadrants of character cell (x,y) are filled, as an index into grainSymbols
+int grainCell(const GrainView *view, int x, int y);
+
+/* The grainCell of every cell in character rows [y0, y0+rows), row by row into idx (rows*width
+   bytes). Unless view->exhaustive is set, the noise's bounded slope is used to find blocks of
+   samples that are all on one side of 0 from a single sample in their middle, so only the areas
+   near the edges of the shapes are sampled in full. The result is the same either way. */
+void grainRows(const GrainView *view, int y0, int rows, unsigned char *idx);
+
+/* The signs of the noise over tile (tx,ty) of the fixed grid of tiles for a seed and zoom, whose
+   sample (i,j) is at (i*zoom, j*zoom); tile (0,0) starts at sample (0,0). GRAIN_TILE*GRAIN_TILE
+   cells, row by row: for each, which quadrants are positive in the low 4 bits and which are
+   negative in the high 4, both in grainSymbols order. */
+void grainTile(int seed, float zoom, int tx, int ty, unsigned char *signs);
+
+// Draw the whole view, one line per row
+void renderGrain(const GrainView *view, FILE *out);
+
+/* Write the view as a binary PBM or PGM image with a pixel per sample, so 2*width by 2*height
+   pixels. Strips of rows are rendered by 'threads' worker threads and written out in order as
+   they finish, so memory use is a few strips however big the image is. Returns 0, or -1 if
+   writing failed. */
+int writeGrainImage(const GrainView *view, FILE *out, GrainFormat format, int threads);
+
+#endif
@@ -0,0 +1,29 @@
+/*
+    cart_screen.h: the terminal renderer ms draws its board with (lib/screen.c).
+
+    The terminal is redrawn from a copy of what it showed last time: each frame only the cells that
+    changed are sent, with cursor addressing, and the whole frame goes out in one write to stdout.
+*/
+
+#ifndef CART_SCREEN_H
+#define CART_SCREEN_H
+
+#include <stddef.h>
+
+#include "cart_board.h"
+
+// Start from { 0 }, which makes the first frame clear the screen and draw everything
+typedef struct {
+    int width, height; // in cells; the heatmap, if shown, doubles the width
+    unsigned short *cells; // each cell as last drawn, colour << 8 | glyph
+    char *buf;
+    size_t len, cap;
+} Screen;
+
+// Draw the board, with the heatmap (see heatmap()) as a second grid to its right if heat isn't NULL,
+// and leave the cursor on the line below it
+void drawBoard(Screen *scr, const MSBoard *msb, const float *heat);
+
+void freeScreen(Screen *scr);
+
+#endif
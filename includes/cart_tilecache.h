@@ -0,0 +1,34 @@
+/*
+    cart_tilecache.h: an on-disk cache of grain's noise tiles (lib/tilecache.c), for drawing
+    overlapping views of the same seed and zoom again and again, as when panning around.
+
+    Each grainTile is a file in the cache directory named by its seed, zoom and tile coordinates,
+    read back with mmap. The file starts with a small header (magic, format version, tile size);
+    one that doesn't match this build's is computed again and written over. A tile's modification
+    time is bumped whenever it's used, and once the tiles add up to more than the size limit the
+    least recently used ones are deleted. Tiles are written to a temporary file and renamed into
+    place, so renders sharing a directory are safe.
+*/
+
+#ifndef CART_TILECACHE_H
+#define CART_TILECACHE_H
+
+#include <stdio.h>
+
+#include "cart_noise.h"
+
+typedef struct {
+    int hits, misses;   // tiles read from the cache and computed
+    int evicted;        // tiles deleted to get back under the limit
+} TileCacheStats;
+
+/* Draw the view like renderGrain, but from the tiles for its seed and zoom, reading the ones in
+   the cache directory 'dir' (made if it isn't there) and adding the rest. The offsets are rounded
+   to whole cells so that the view's cells line up with the tiles', which means the picture can
+   differ from renderGrain's by a sample here and there where the float coordinates round
+   differently. Then tiles are evicted down to maxBytes. Returns 0, or -1 if the directory can't
+   be made or read, and fills in stats if it isn't NULL. */
+int renderGrainCached(const GrainView *view, const char *dir, long long maxBytes, FILE *out,
+                      TileCacheStats *stats);
+
+#endif
@@ -0,0 +1,1181 @@
+// mssolver.h - Minesweeper solver
+//
+// to create the implementation,
+//     #define MS_SOLVER_IMPLEMENTATION
+// in *one* C file that includes this file.
+//
+//
+// Documentation:
+//
+// int ms_solve(const signed char *view, int width, int height, int mines, signed char *out)
+//
+// Works out which covered cells are certainly safe and which are certainly mines, from only what
+// a player can see. 'view' holds width*height cells in row-major order: 0-8 for a revealed number,
+// MS_UNKNOWN for a covered cell, or MS_MINE for a cell already known to be a mine (a trusted flag,
+// or an earlier deduction). 'mines' is the number of mines on the whole board, or -1 to leave the
+// total out of the reasoning.
+//
+// On return 'out' (also width*height) holds MS_SAFE or MS_MINE for each covered cell that could be
+// decided and MS_UNKNOWN for the rest; revealed numbers and known mines are copied across. 'out'
+// may be the same array as 'view'. Returns the number of covered cells that were decided, or -1 if
+// it ran out of memory (when 'out' still holds whatever had been decided by then, all of it sound).
+//
+// The easy cases are handled with the single-cell rule (a number whose mines are all accounted for
+// clears its other neighbours; one with as many covered neighbours as missing mines makes them all
+// mines) and the pairwise rule between overlapping numbers. Each number keeps its covered
+// neighbours as an 8-bit mask, and a pair is compared as bitboards of the 7x7 window around them,
+// so neither rule ever walks the board. Whatever frontier is left is split into independent
+// components and each one is enumerated exactly; a component that takes more than MS_ENUM_BUDGET
+// search steps is left undecided.
+//
+//
+// int ms_probabilities(const signed char *view, int width, int height, int mines,
+//                      int threads, float *prob)
+//
+// Fills 'prob' (width*height) with the chance that each covered cell of 'view' (as for ms_solve)
+// is a mine, given everything visible and the total 'mines', assuming every consistent layout is
+// equally likely. Revealed cells get -1. Returns 1 if 'view' has no consistent layout, or -1 if it
+// ran out of memory, when every covered cell is given the average density of the mines left.
+//
+// After the same local rules as ms_solve, each frontier component is enumerated exactly, giving its
+// solution counts by number of mines. Components are independent apart from sharing the remaining
+// mines with each other and the cells off the frontier, so they are combined by convolving those
+// counts and weighting each total with the number of ways to place the rest off the frontier.
+// Which cells are mines in how many solutions is only kept for the mine counts the solutions
+// actually have, a narrow band for a big component, so memory stays close to linear in its size.
+// A component too big to enumerate is sampled instead, with 'threads' Markov chains that each
+// repeatedly pick a block of up to MS_MC_BLOCK neighbouring cells and redraw it uniformly from all
+// of its consistent assignments. MS_MC_SAMPLES samples are taken across the chains, so these
+// probabilities are estimates.
+//
+// int ms_generate_noguess(int width, int height, int mines, int x, int y,
+//                         unsigned int seed, int threads, unsigned char *layout)
+//
+// Fills 'layout' (width*height, row-major) with 1 for a mine and 0 otherwise, such that the 3x3
+// area around the first click (x,y) is clear and the whole board can then be cleared by ms_solve
+// alone, never needing a guess. Returns 0 on success, or nonzero if no such board turned up within
+// MS_GEN_BUDGET solver play-throughs per thread (as happens for very dense boards) or there wasn't
+// the memory to look.
+//
+// Each attempt plays the board out with the solver. When it gets stuck, one mine on the stuck
+// frontier is moved to a random covered cell away from it, with the counts updated incrementally,
+// and the board is played again; after MS_GEN_MOVES moves it starts over from a fresh layout.
+// 'threads' workers race on independent random streams derived from 'seed' and the first valid
+// board wins, so with threads > 1 the result also depends on timing. Link with -pthread.
+//
+
+
+#ifndef MS_SOLVER_H
+#define MS_SOLVER_H
+
+#define MS_UNKNOWN -1
+#define MS_MINE    -2
+#define MS_SAFE    -3
+
+#ifndef MS_ENUM_BUDGET
+#define MS_ENUM_BUDGET (1 << 20)
+#endif
+
+#ifndef MS_MC_BLOCK
+#define MS_MC_BLOCK 12
+#endif
+
+#ifndef MS_MC_SAMPLES
+#define MS_MC_SAMPLES 4096
+#endif
+
+#ifndef MS_GEN_BUDGET
+#define MS_GEN_BUDGET 20000
+#endif
+
+#ifndef MS_GEN_MOVES
+#define MS_GEN_MOVES 64
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern int ms_solve(const signed char *view, int width, int height, int mines, signed char *out);
+extern int ms_probabilities(const signed char *view, int width, int height, int mines,
+                            int threads, float *prob);
+extern int ms_generate_noguess(int width, int height, int mines, int x, int y,
+                               unsigned int seed, int threads, unsigned char *layout);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MS_SOLVER_H
+
+#ifdef MS_SOLVER_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+// neighbour k of a cell; neighbour 7-k is always the opposite direction
+static const int ms__dx[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+static const int ms__dy[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+
+typedef struct
+{
+   int cell;           // the revealed number this comes from
+   int need;           // mines still missing around it
+   unsigned char mask; // which of its neighbours are still covered and undecided
+} ms__constraint;
+
+typedef struct
+{
+   int width, height;
+   signed char *state; // the view, with decisions filled in as they are made
+   int *owner;         // constraint index of each revealed cell, -1 for the rest
+   int *scratch;       // width*height ints for the enumeration pass
+   ms__constraint *cons;
+   int num_cons;
+   int decided;
+} ms__solver;
+
+static int ms__popcount(unsigned long long v)
+{
+   int n = 0;
+   for (; v; v &= v-1) n++;
+   return n;
+}
+
+// the 8-bit neighbour mask spread out into a 3x3 block of a window with rows 8 bits apart
+static unsigned long long ms__spread(unsigned char mask)
+{
+   unsigned long long r = 0;
+   for (int k = 0; k < 8; k++)
+      if (mask >> k & 1)
+         r |= 1ull << ((ms__dy[k]+1)*8 + ms__dx[k]+1);
+   return r;
+}
+
+static void ms__decide(ms__solver *s, int cell, int is_mine)
+{
+   int x = cell % s->width, y = cell / s->width;
+   s->state[cell] = is_mine ? MS_MINE : MS_SAFE;
+   s->decided++;
+   for (int k = 0; k < 8; k++) {
+      int nx = x + ms__dx[k], ny = y + ms__dy[k];
+      if (nx < 0 || nx >= s->width || ny < 0 || ny >= s->height) continue;
+      int ci = s->owner[ny*s->width + nx];
+      if (ci < 0) continue;
+      s->cons[ci].mask &= ~(1 << (7-k));
+      if (is_mine) s->cons[ci].need--;
+   }
+}
+
+// decide every cell of a 7x7 window centred on 'centre' whose bit is set
+static void ms__decide_window(ms__solver *s, int centre, unsigned long long bits, int is_mine)
+{
+   for (; bits; bits &= bits-1) {
+      int b = __builtin_ctzll(bits);
+      int cell = centre + ((b >> 3) - 3)*s->width + (b & 7) - 3;
+      if (s->state[cell] == MS_UNKNOWN) ms__decide(s, cell, is_mine);
+   }
+}
+
+static int ms__local_rules(ms__solver *s)
+{
+   int changed = 0;
+
+   // single-cell rule
+   for (int i = 0; i < s->num_cons; i++) {
+      ms__constraint *c = &s->cons[i];
+      if (!c->mask) continue;
+      int covered = ms__popcount(c->mask);
+      if (c->need == 0 || c->need == covered) {
+         ms__decide_window(s, c->cell, ms__spread(c->mask) << (2*8+2), c->need != 0);
+         changed = 1;
+      }
+   }
+   if (changed) return 1;
+
+   // pairwise rule: if B needs exactly as many more mines than A as it has cells A doesn't, those
+   // cells are all mines and A's cells outside B are all safe
+   for (int i = 0; i < s->num_cons; i++) {
+      ms__constraint *a = &s->cons[i];
+      int ax = a->cell % s->width, ay = a->cell / s->width;
+      for (int dy = -2; dy <= 2 && a->mask; dy++) {
+         if (ay + dy < 0 || ay + dy >= s->height) continue;
+         for (int dx = -2; dx <= 2 && a->mask; dx++) {
+            if (ax + dx < 0 || ax + dx >= s->width || (dx == 0 && dy == 0)) continue;
+            int bi = s->owner[a->cell + dy*s->width + dx];
+            if (bi < 0 || !s->cons[bi].mask) continue;
+            ms__constraint *b = &s->cons[bi];
+
+            unsigned long long fa = ms__spread(a->mask) << (2*8+2);
+            unsigned long long fb = ms__spread(b->mask) << ((2+dy)*8 + 2+dx);
+            if (!(fa & fb)) continue;
+            unsigned long long only_a = fa & ~fb, only_b = fb & ~fa;
+            if ((only_a || only_b) && b->need - a->need == ms__popcount(only_b)) {
+               ms__decide_window(s, a->cell, only_b, 1);
+               ms__decide_window(s, a->cell, only_a, 0);
+               changed = 1;
+            }
+         }
+      }
+   }
+   return changed;
+}
+
+typedef struct
+{
+   int nv;
+   int *cells;       // component cells in search order
+   int *var_cons;    // up to 8 constraint indices per variable
+   int *var_ncons;
+   int *cons_mines;  // per constraint (indexed like s->cons): mines placed so far...
+   int *cons_left;   // ...and covered cells not yet assigned
+   char *value;
+   double *solutions; // solutions[k]: solutions with k mines in the component
+   double *hits;      // hits[v*hits_width + k-hits_lo]: of those, how many have variable v as a mine
+   int hits_lo, hits_width; // the mine counts any solution has had so far
+   long steps;
+   int aborted;
+   int failed;        // out of memory, so aborted too
+} ms__enum;
+
+// Widen a hits table (hits[v*width + k-lo], nv variables) to take solutions with k mines. It only
+// ever covers the counts that turn up, which for a big component are a narrow band, and grows by
+// half again each time so that a drifting count doesn't copy it over and over. Returns 0, or -1
+// if out of memory, leaving it as it was.
+static int ms__hits_cover(double **hits, int nv, int *lo, int *width, int k)
+{
+   if (*width > 0 && k >= *lo && k < *lo + *width) return 0;
+   int new_lo = k, new_hi = k;
+   if (*width > 0) {
+      int slack = *width / 2;
+      new_lo = k < *lo ? k - slack : *lo;
+      new_hi = k >= *lo + *width ? k + slack : *lo + *width - 1;
+      if (new_lo < 0) new_lo = 0;
+      if (new_hi > nv) new_hi = nv;
+   }
+   int new_width = new_hi - new_lo + 1;
+   double *h = (double *) calloc((size_t) nv * new_width, sizeof(double));
+   if (!h) return -1;
+   if (*width > 0)
+      for (size_t v = 0; v < (size_t) nv; v++)
+         memcpy(h + v*new_width + (*lo - new_lo), *hits + v * *width, sizeof(double) * *width);
+   free(*hits);
+   *hits = h;
+   *lo = new_lo;
+   *width = new_width;
+   return 0;
+}
+
+static void ms__enumerate(ms__solver *s, ms__enum *e, int v, int mines)
+{
+   if (++e->steps > MS_ENUM_BUDGET) { e->aborted = 1; return; }
+   if (v == e->nv) {
+      if (ms__hits_cover(&e->hits, e->nv, &e->hits_lo, &e->hits_width, mines)) {
+         e->aborted = e->failed = 1;
+         return;
+      }
+      e->solutions[mines] += 1;
+      for (size_t i = 0; i < (size_t) e->nv; i++)
+         if (e->value[i]) e->hits[i*e->hits_width + mines - e->hits_lo] += 1;
+      return;
+   }
+
+   int *cons = &e->var_cons[v*8];
+   for (int val = 0; val <= 1 && !e->aborted; val++) {
+      int ok = 1;
+      for (int j = 0; j < e->var_ncons[v]; j++) {
+         int c = cons[j];
+         e->cons_left[c]--;
+         e->cons_mines[c] += val;
+         if (e->cons_mines[c] > s->cons[c].need || e->cons_mines[c] + e->cons_left[c] < s->cons[c].need)
+            ok = 0;
+      }
+      if (ok) {
+         e->value[v] = val;
+         ms__enumerate(s, e, v+1, mines + val);
+      }
+      for (int j = 0; j < e->var_ncons[v]; j++) {
+         e->cons_left[cons[j]]++;
+         e->cons_mines[cons[j]] -= val;
+      }
+   }
+}
+
+static int ms__find(int *parent, int i)
+{
+   while (parent[i] != i) i = parent[i] = parent[parent[i]];
+   return i;
+}
+
+// Split the undecided frontier into components and call fn on each one after enumerating it. If the
+// enumeration ran out of budget e->aborted is set, and only the component's cells are meaningful.
+// Returns 0, or -1 if out of memory here or in fn (which returns the same).
+static int ms__components(ms__solver *s, int (*fn)(ms__solver *, ms__enum *, void *), void *user)
+{
+   int n = s->width * s->height;
+   int *var_of = s->scratch; // frontier variable index of each cell, -1 if not on the frontier
+   for (int i = 0; i < n; i++) var_of[i] = -1;
+
+   int nv = 0;
+   int *cells = (int *) malloc(sizeof(int) * n);
+   if (!cells) return -1;
+   for (int i = 0; i < s->num_cons; i++) {
+      ms__constraint *c = &s->cons[i];
+      for (int k = 0; k < 8; k++) {
+         if (!(c->mask >> k & 1)) continue;
+         int cell = c->cell + ms__dy[k]*s->width + ms__dx[k];
+         if (var_of[cell] < 0) { var_of[cell] = nv; cells[nv++] = cell; }
+      }
+   }
+   if (nv == 0) { free(cells); return 0; }
+
+   int *parent = (int *) malloc(sizeof(int) * nv);
+   if (!parent) { free(cells); return -1; }
+   for (int i = 0; i < nv; i++) parent[i] = i;
+   for (int i = 0; i < s->num_cons; i++) {
+      ms__constraint *c = &s->cons[i];
+      int first = -1;
+      for (int k = 0; k < 8; k++) {
+         if (!(c->mask >> k & 1)) continue;
+         int v = var_of[c->cell + ms__dy[k]*s->width + ms__dx[k]];
+         if (first < 0) first = v;
+         else parent[ms__find(parent, v)] = ms__find(parent, first);
+      }
+   }
+
+   ms__enum e;
+   e.cells = (int *) malloc(sizeof(int) * nv);
+   e.var_cons = (int *) malloc(sizeof(int) * nv * 8);
+   e.var_ncons = (int *) malloc(sizeof(int) * nv);
+   e.cons_mines = (int *) calloc(s->num_cons, sizeof(int));
+   e.cons_left = (int *) calloc(s->num_cons, sizeof(int));
+   e.value = (char *) malloc(nv);
+   int *order = (int *) malloc(sizeof(int) * nv);
+   char *seen = (char *) calloc(nv, 1);
+   int failed = !e.cells || !e.var_cons || !e.var_ncons || !e.cons_mines || !e.cons_left
+             || !e.value || !order || !seen;
+
+   for (int root = 0; root < nv && !failed; root++) {
+      if (ms__find(parent, root) != root) continue;
+
+      // Breadth-first over the component so each number's cells come close together in the
+      // search order and its constraint closes (and prunes) early.
+      int head = 0, tail = 0;
+      for (int i = 0; i < nv; i++)
+         if (!seen[i] && ms__find(parent, i) == root) { order[tail++] = i; seen[i] = 1; break; }
+      while (head < tail) {
+         int cell = cells[order[head++]];
+         int x = cell % s->width, y = cell / s->width;
+         for (int k = 0; k < 8; k++) {
+            int nx = x + ms__dx[k], ny = y + ms__dy[k];
+            if (nx < 0 || nx >= s->width || ny < 0 || ny >= s->height) continue;
+            int ci = s->owner[ny*s->width + nx];
+            if (ci < 0) continue;
+            ms__constraint *c = &s->cons[ci];
+            for (int j = 0; j < 8; j++) {
+               if (!(c->mask >> j & 1)) continue;
+               int v = var_of[c->cell + ms__dy[j]*s->width + ms__dx[j]];
+               if (!seen[v]) { seen[v] = 1; order[tail++] = v; }
+            }
+         }
+      }
+
+      e.nv = tail;
+      for (int i = 0; i < tail; i++) {
+         int cell = cells[order[i]];
+         int x = cell % s->width, y = cell / s->width;
+         e.cells[i] = cell;
+         e.var_ncons[i] = 0;
+         for (int k = 0; k < 8; k++) {
+            int nx = x + ms__dx[k], ny = y + ms__dy[k];
+            if (nx < 0 || nx >= s->width || ny < 0 || ny >= s->height) continue;
+            int ci = s->owner[ny*s->width + nx];
+            if (ci < 0 || !(s->cons[ci].mask >> (7-k) & 1)) continue;
+            e.var_cons[i*8 + e.var_ncons[i]++] = ci;
+            e.cons_left[ci]++;
+         }
+      }
+
+      e.solutions = (double *) calloc(tail+1, sizeof(double));
+      e.hits = NULL;
+      e.hits_lo = e.hits_width = 0;
+      e.steps = 0;
+      e.aborted = e.failed = 0;
+      if (!e.solutions) failed = 1;
+      else {
+         ms__enumerate(s, &e, 0, 0);
+         if (e.failed || fn(s, &e, user)) failed = 1;
+      }
+      free(e.solutions);
+      free(e.hits);
+
+      for (int i = 0; i < tail; i++)
+         for (int j = 0; j < e.var_ncons[i]; j++)
+            e.cons_left[e.var_cons[i*8 + j]] = 0;
+   }
+
+   free(order); free(seen);
+   free(e.cells); free(e.var_cons); free(e.var_ncons);
+   free(e.cons_mines); free(e.cons_left); free(e.value);
+   free(parent); free(cells);
+   return failed ? -1 : 0;
+}
+
+// decide the component cells that are a mine in every solution or in none
+static int ms__decide_component(ms__solver *s, ms__enum *e, void *user)
+{
+   int max_mines = *(int *) user;
+   double total = 0;
+   if (e->aborted) return 0;
+   for (int k = 0; k <= e->nv && k <= max_mines; k++) total += e->solutions[k];
+   if (total == 0) return 0; // inconsistent view
+
+   for (size_t v = 0; v < (size_t) e->nv; v++) {
+      double hits = 0;
+      for (int k = e->hits_lo; k < e->hits_lo + e->hits_width && k <= max_mines; k++)
+         hits += e->hits[v*e->hits_width + k - e->hits_lo];
+      if (hits == 0) ms__decide(s, e->cells[v], 0);
+      else if (hits == total) ms__decide(s, e->cells[v], 1);
+   }
+   return 0;
+}
+
+static int ms__global_rule(ms__solver *s, int mines)
+{
+   int n = s->width * s->height, covered = 0, known = 0;
+   if (mines < 0) return 0;
+   for (int i = 0; i < n; i++) {
+      if (s->state[i] == MS_UNKNOWN) covered++;
+      else if (s->state[i] == MS_MINE) known++;
+   }
+   if (covered == 0 || (mines - known != 0 && mines - known != covered)) return 0;
+   for (int i = 0; i < n; i++)
+      if (s->state[i] == MS_UNKNOWN) ms__decide(s, i, mines != known);
+   return 1;
+}
+
+static void ms__free(ms__solver *s)
+{
+   free(s->owner);
+   free(s->scratch);
+   free(s->cons);
+}
+
+// Returns 0, or -1 (with nothing left to free) if out of memory
+static int ms__init(ms__solver *s, const signed char *view, int width, int height, signed char *state)
+{
+   int n = width * height;
+   s->width = width;
+   s->height = height;
+   s->state = state;
+   if (state != view) memcpy(state, view, n);
+   s->owner = (int *) malloc(sizeof(int) * n);
+   s->scratch = (int *) malloc(sizeof(int) * n);
+   s->cons = NULL;
+   s->num_cons = 0;
+   s->decided = 0;
+   if (!s->owner || !s->scratch) { ms__free(s); return -1; }
+
+   int cap = 0;
+   for (int i = 0; i < n; i++) {
+      s->owner[i] = -1;
+      if (state[i] < 0) continue;
+      int x = i % width, y = i / width;
+      ms__constraint c = { i, state[i], 0 };
+      for (int k = 0; k < 8; k++) {
+         int nx = x + ms__dx[k], ny = y + ms__dy[k];
+         if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+         signed char v = state[ny*width + nx];
+         if (v == MS_UNKNOWN) c.mask |= 1 << k;
+         else if (v == MS_MINE) c.need--;
+      }
+      if (!c.mask) continue;
+      if (s->num_cons == cap) {
+         cap = cap ? cap*2 : 64;
+         ms__constraint *cons = (ms__constraint *) realloc(s->cons, sizeof(ms__constraint) * cap);
+         if (!cons) { ms__free(s); return -1; }
+         s->cons = cons;
+      }
+      s->owner[i] = s->num_cons;
+      s->cons[s->num_cons++] = c;
+   }
+   return 0;
+}
+
+int ms_solve(const signed char *view, int width, int height, int mines, signed char *out)
+{
+   ms__solver s;
+   if (ms__init(&s, view, width, height, out)) return -1;
+   int failed = 0;
+
+   for (;;) {
+      if (ms__local_rules(&s)) continue;
+      if (ms__global_rule(&s, mines)) continue;
+
+      int before = s.decided;
+      int max_mines = width * height;
+      if (mines >= 0) {
+         max_mines = mines;
+         for (int i = 0; i < width*height; i++)
+            if (s.state[i] == MS_MINE) max_mines--;
+      }
+      if (ms__components(&s, ms__decide_component, &max_mines)) { failed = 1; break; }
+      if (s.decided == before) break;
+   }
+
+   ms__free(&s);
+   return failed ? -1 : s.decided;
+}
+
+// Mine probabilities
+
+typedef struct
+{
+   int nv;
+   int *cells;
+   double *solutions; // as in ms__enum, scaled to sum to 1
+   double *hits;
+   int hits_lo, hits_width;
+} ms__component;
+
+typedef struct
+{
+   ms__component *comps;
+   int num, cap;
+   int threads;
+} ms__prob_ctx;
+
+typedef struct
+{
+   ms__solver *s;
+   ms__enum *e;
+   const int *cons_vars;  // component variables of each constraint, 8 slots apiece
+   const int *cons_nvars;
+   int samples;
+   unsigned int rng;
+   double *solutions, *hits; // as in ms__enum, hits with its own window of mine counts
+   int hits_lo, hits_width;
+   int ok;
+   int failed;            // out of memory
+} ms__chain;
+
+static unsigned int ms__rand(unsigned int *state);
+
+// randomised depth-first search for any one solution, to start a chain from
+static int ms__chain_start(ms__chain *c, char *value, int *cons_mines, int *cons_left, int v, long *steps)
+{
+   ms__enum *e = c->e;
+   if (v == e->nv) return 1;
+   if (++*steps > MS_ENUM_BUDGET) return 0;
+
+   int first = ms__rand(&c->rng) & 1;
+   for (int t = 0; t < 2; t++) {
+      int val = first ^ t, ok = 1;
+      for (int j = 0; j < e->var_ncons[v]; j++) {
+         int ci = e->var_cons[v*8 + j];
+         cons_left[ci]--;
+         cons_mines[ci] += val;
+         if (cons_mines[ci] > c->s->cons[ci].need || cons_mines[ci] + cons_left[ci] < c->s->cons[ci].need)
+            ok = 0;
+      }
+      value[v] = val;
+      if (ok && ms__chain_start(c, value, cons_mines, cons_left, v+1, steps)) return 1;
+      for (int j = 0; j < e->var_ncons[v]; j++) {
+         int ci = e->var_cons[v*8 + j];
+         cons_left[ci]++;
+         cons_mines[ci] -= val;
+      }
+   }
+   return 0;
+}
+
+// every consistent assignment of the block, as bitmasks
+static void ms__block_enum(ms__chain *c, const int *block, int size, int i, unsigned int mask,
+                           int *cons_mines, int *cons_left, unsigned int *out, int *num_out)
+{
+   ms__enum *e = c->e;
+   if (i == size) { out[(*num_out)++] = mask; return; }
+   int v = block[i];
+   for (int val = 0; val <= 1; val++) {
+      int ok = 1;
+      for (int j = 0; j < e->var_ncons[v]; j++) {
+         int ci = e->var_cons[v*8 + j];
+         cons_left[ci]--;
+         cons_mines[ci] += val;
+         if (cons_mines[ci] > c->s->cons[ci].need || cons_mines[ci] + cons_left[ci] < c->s->cons[ci].need)
+            ok = 0;
+      }
+      if (ok) ms__block_enum(c, block, size, i+1, mask | (unsigned) val << i, cons_mines, cons_left, out, num_out);
+      for (int j = 0; j < e->var_ncons[v]; j++) {
+         int ci = e->var_cons[v*8 + j];
+         cons_left[ci]++;
+         cons_mines[ci] -= val;
+      }
+   }
+}
+
+static void *ms__chain_run(void *arg)
+{
+   ms__chain *c = (ms__chain *) arg;
+   ms__enum *e = c->e;
+   int nv = e->nv, num_cons = c->s->num_cons;
+   char *value = (char *) malloc(nv);
+   char *in_block = (char *) calloc(nv, 1);
+   int *cons_mines = (int *) calloc(num_cons, sizeof(int));
+   int *cons_left = (int *) calloc(num_cons, sizeof(int));
+   unsigned int *sols = (unsigned int *) malloc(sizeof(unsigned int) << MS_MC_BLOCK);
+   int block[MS_MC_BLOCK];
+   long steps = 0;
+   if (!value || !in_block || !cons_mines || !cons_left || !sols) {
+      c->failed = 1;
+      free(value); free(in_block); free(cons_mines); free(cons_left); free(sols);
+      return NULL;
+   }
+
+   // cons_left only counts the block during updates; the start search needs every variable in it
+   for (int v = 0; v < nv; v++)
+      for (int j = 0; j < e->var_ncons[v]; j++) cons_left[e->var_cons[v*8 + j]]++;
+   c->ok = ms__chain_start(c, value, cons_mines, cons_left, 0, &steps);
+   for (int v = 0; v < nv; v++)
+      for (int j = 0; j < e->var_ncons[v]; j++) cons_left[e->var_cons[v*8 + j]] = 0;
+
+   int mines = 0;
+   for (int v = 0; v < nv; v++) mines += value[v];
+   int burn_in = c->samples / 8;
+   int updates = nv / MS_MC_BLOCK + 1;
+
+   for (int n = 0; c->ok && n < burn_in + c->samples; n++) {
+      for (int u = 0; u < updates; u++) {
+         // grow a block breadth-first from a random cell through shared numbers
+         int size = 0;
+         block[size++] = ms__rand(&c->rng) % nv;
+         in_block[block[0]] = 1;
+         for (int h = 0; h < size && size < MS_MC_BLOCK; h++) {
+            int v = block[h];
+            for (int j = 0; j < e->var_ncons[v] && size < MS_MC_BLOCK; j++) {
+               int ci = e->var_cons[v*8 + j];
+               for (int k = 0; k < c->cons_nvars[ci] && size < MS_MC_BLOCK; k++) {
+                  int w = c->cons_vars[ci*8 + k];
+                  if (!in_block[w]) { in_block[w] = 1; block[size++] = w; }
+               }
+            }
+         }
+
+         // lift the block out, then put back a uniformly chosen consistent assignment of it
+         for (int i = 0; i < size; i++) {
+            int v = block[i];
+            mines -= value[v];
+            for (int j = 0; j < e->var_ncons[v]; j++) {
+               int ci = e->var_cons[v*8 + j];
+               cons_mines[ci] -= value[v];
+               cons_left[ci]++;
+            }
+         }
+         int num_sols = 0;
+         ms__block_enum(c, block, size, 0, 0, cons_mines, cons_left, sols, &num_sols);
+         unsigned int pick = sols[ms__rand(&c->rng) % num_sols];
+         for (int i = 0; i < size; i++) {
+            int v = block[i];
+            value[v] = pick >> i & 1;
+            mines += value[v];
+            in_block[v] = 0;
+            for (int j = 0; j < e->var_ncons[v]; j++) {
+               int ci = e->var_cons[v*8 + j];
+               cons_mines[ci] += value[v];
+               cons_left[ci]--;
+            }
+         }
+      }
+
+      if (n < burn_in) continue;
+      // the chain wanders over a narrow band of mine counts, so that's all its hits cover
+      if (ms__hits_cover(&c->hits, nv, &c->hits_lo, &c->hits_width, mines)) {
+         c->ok = 0;
+         c->failed = 1;
+         break;
+      }
+      c->solutions[mines] += 1;
+      for (size_t v = 0; v < (size_t) nv; v++)
+         if (value[v]) c->hits[v*c->hits_width + mines - c->hits_lo] += 1;
+   }
+
+   free(value); free(in_block); free(cons_mines); free(cons_left); free(sols);
+   return NULL;
+}
+
+// estimate a component's solution counts by sampling when it is too big to enumerate
+static int ms__sample_component(ms__solver *s, ms__enum *e, int threads)
+{
+   int nv = e->nv;
+   int *cons_vars = (int *) malloc(sizeof(int) * s->num_cons * 8);
+   int *cons_nvars = (int *) calloc(s->num_cons, sizeof(int));
+   ms__chain *chains = (ms__chain *) calloc(threads, sizeof(ms__chain));
+   pthread_t *tids = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+   char *started = (char *) calloc(threads, 1);
+   if (!cons_vars || !cons_nvars || !chains || !tids || !started) {
+      e->failed = 1;
+      free(chains); free(tids); free(started);
+      free(cons_vars); free(cons_nvars);
+      return 0;
+   }
+   for (int v = 0; v < nv; v++)
+      for (int j = 0; j < e->var_ncons[v]; j++) {
+         int ci = e->var_cons[v*8 + j];
+         cons_vars[ci*8 + cons_nvars[ci]++] = v;
+      }
+
+   for (int t = 0; t < threads; t++) {
+      ms__chain *c = &chains[t];
+      c->s = s;
+      c->e = e;
+      c->cons_vars = cons_vars;
+      c->cons_nvars = cons_nvars;
+      c->samples = (MS_MC_SAMPLES + threads-1) / threads;
+      c->rng = (0x2545f491u * (t+1) ^ (unsigned) nv) | 1;
+      c->solutions = (double *) calloc(nv+1, sizeof(double));
+      if (!c->solutions) c->failed = 1;
+   }
+   // the calling thread runs chain 0
+   for (int t = 1; t < threads; t++)
+      started[t] = !chains[t].failed && !pthread_create(&tids[t], NULL, ms__chain_run, &chains[t]);
+   if (!chains[0].failed) ms__chain_run(&chains[0]);
+   for (int t = 1; t < threads; t++)
+      if (started[t]) pthread_join(tids[t], NULL);
+      else if (!chains[t].failed) ms__chain_run(&chains[t]);
+
+   int ok = 0;
+   for (int t = 0; t < threads; t++) {
+      ms__chain *c = &chains[t];
+      if (c->failed) e->failed = 1;
+      if (c->ok && !e->failed) {
+         int hi = c->hits_lo + c->hits_width - 1;
+         if (ms__hits_cover(&e->hits, nv, &e->hits_lo, &e->hits_width, c->hits_lo)
+             || ms__hits_cover(&e->hits, nv, &e->hits_lo, &e->hits_width, hi)) {
+            e->failed = 1;
+         } else {
+            ok = 1;
+            for (int k = 0; k <= nv; k++) e->solutions[k] += c->solutions[k];
+            for (size_t v = 0; v < (size_t) nv; v++)
+               for (int k = 0; k < c->hits_width; k++)
+                  e->hits[v*e->hits_width + c->hits_lo + k - e->hits_lo] += c->hits[v*c->hits_width + k];
+         }
+      }
+      free(c->solutions);
+      free(c->hits);
+   }
+   free(chains); free(tids); free(started);
+   free(cons_vars); free(cons_nvars);
+   return ok;
+}
+
+static int ms__collect_component(ms__solver *s, ms__enum *e, void *user)
+{
+   ms__prob_ctx *ctx = (ms__prob_ctx *) user;
+   int nv = e->nv;
+
+   if (e->aborted) {
+      memset(e->solutions, 0, sizeof(double) * (nv+1));
+      free(e->hits);
+      e->hits = NULL;
+      e->hits_lo = e->hits_width = 0;
+      int ok = ms__sample_component(s, e, ctx->threads);
+      if (e->failed) return -1;
+      if (!ok) return 0;
+   }
+
+   double total = 0;
+   for (int k = 0; k <= nv; k++) total += e->solutions[k];
+   if (total == 0) return 0;
+
+   if (ctx->num == ctx->cap) {
+      int cap = ctx->cap ? ctx->cap*2 : 16;
+      ms__component *comps = (ms__component *) realloc(ctx->comps, sizeof(ms__component) * cap);
+      if (!comps) return -1;
+      ctx->comps = comps;
+      ctx->cap = cap;
+   }
+   ms__component *c = &ctx->comps[ctx->num];
+   size_t num_hits = (size_t) nv * e->hits_width;
+   c->nv = nv;
+   c->hits_lo = e->hits_lo;
+   c->hits_width = e->hits_width;
+   c->cells = (int *) malloc(sizeof(int) * nv);
+   c->solutions = (double *) malloc(sizeof(double) * (nv+1));
+   c->hits = (double *) malloc(sizeof(double) * num_hits);
+   if (!c->cells || !c->solutions || !c->hits) {
+      free(c->cells); free(c->solutions); free(c->hits);
+      return -1;
+   }
+   ctx->num++;
+   memcpy(c->cells, e->cells, sizeof(int) * nv);
+   for (int k = 0; k <= nv; k++) c->solutions[k] = e->solutions[k] / total;
+   for (size_t i = 0; i < num_hits; i++) c->hits[i] = e->hits[i] / total;
+   return 0;
+}
+
+// out[0..na+nb] = a (*) b
+static void ms__convolve(const double *a, int na, const double *b, int nb, double *out)
+{
+   for (int i = 0; i <= na + nb; i++) out[i] = 0;
+   for (int i = 0; i <= na; i++)
+      for (int j = 0; j <= nb && a[i] != 0; j++)
+         out[i+j] += a[i] * b[j];
+}
+
+// distribution of the total mines in every component except 'skip'; returns its largest total
+static int ms__rest(ms__prob_ctx *ctx, int skip, double *dist, double *tmp)
+{
+   int n = 0;
+   dist[0] = 1;
+   for (int c = 0; c < ctx->num; c++) {
+      if (c == skip) continue;
+      ms__convolve(dist, n, ctx->comps[c].solutions, ctx->comps[c].nv, tmp);
+      n += ctx->comps[c].nv;
+      memcpy(dist, tmp, sizeof(double) * (n+1));
+   }
+   return n;
+}
+
+// Combine the components into 'prob'. Returns 0, 1 if there is no consistent layout, or -1 if out
+// of memory.
+static int ms__combine(ms__prob_ctx *ctx, const signed char *state, int n, int mines, float *prob)
+{
+   // what is left over for the cells that aren't on any frontier
+   int frontier = 0, off = 0, remaining = mines;
+   char *on_frontier = (char *) calloc(n, 1);
+   if (!on_frontier) return -1;
+   for (int c = 0; c < ctx->num; c++)
+      for (int v = 0; v < ctx->comps[c].nv; v++) on_frontier[ctx->comps[c].cells[v]] = 1;
+   for (int i = 0; i < n; i++) {
+      if (state[i] == MS_MINE) remaining--;
+      else if (state[i] == MS_UNKNOWN && !on_frontier[i]) off++;
+      frontier += on_frontier[i];
+   }
+   free(on_frontier);
+
+   // weight[K]: ways to place the other remaining - K mines off the frontier, scaled by the largest
+   double *weight = (double *) calloc(frontier+1, sizeof(double));
+   double *dist = (double *) malloc(sizeof(double) * (frontier+1));
+   double *tmp = (double *) malloc(sizeof(double) * (frontier+1));
+   if (!weight || !dist || !tmp) {
+      free(weight); free(dist); free(tmp);
+      return -1;
+   }
+   double top = -HUGE_VAL;
+   for (int k = 0; k <= frontier; k++) {
+      int rest = remaining - k;
+      weight[k] = (rest < 0 || rest > off) ? -HUGE_VAL
+                : lgamma(off+1.0) - lgamma(rest+1.0) - lgamma(off-rest+1.0);
+      if (weight[k] > top) top = weight[k];
+   }
+   for (int k = 0; k <= frontier; k++) weight[k] = weight[k] == -HUGE_VAL ? 0 : exp(weight[k] - top);
+
+   int all = ms__rest(ctx, -1, dist, tmp);
+   double total = 0, off_mines = 0;
+   for (int k = 0; k <= all; k++) {
+      total += dist[k] * weight[k];
+      off_mines += dist[k] * weight[k] * (remaining - k);
+   }
+
+   int failed = total == 0;
+   for (int i = 0; i < n; i++) {
+      if (state[i] >= 0) prob[i] = -1;
+      else if (state[i] == MS_MINE) prob[i] = 1;
+      else if (state[i] == MS_SAFE) prob[i] = 0;
+      else prob[i] = failed || off == 0 ? 0 : (float) (off_mines / total / off);
+   }
+
+   for (int c = 0; c < ctx->num && !failed; c++) {
+      ms__component *comp = &ctx->comps[c];
+      int others = ms__rest(ctx, c, dist, tmp);
+      // with k mines in this component, the weight of everything else
+      for (int k = 0; k <= comp->nv; k++) {
+         double w = 0;
+         for (int j = 0; j <= others; j++) w += dist[j] * weight[k+j];
+         tmp[k] = w;
+      }
+      for (size_t v = 0; v < (size_t) comp->nv; v++) {
+         double p = 0;
+         for (int k = 0; k < comp->hits_width; k++)
+            p += comp->hits[v*comp->hits_width + k] * tmp[comp->hits_lo + k];
+         prob[comp->cells[v]] = (float) (p / total);
+      }
+   }
+
+   free(weight); free(dist); free(tmp);
+   return failed;
+}
+
+// When out of memory, every covered cell gets the average of the mines left
+static int ms__probabilities_failed(const signed char *view, int n, int mines, float *prob)
+{
+   int covered = 0;
+   for (int i = 0; i < n; i++) {
+      if (view[i] == MS_UNKNOWN) covered++;
+      else if (view[i] == MS_MINE) mines--;
+   }
+   for (int i = 0; i < n; i++)
+      prob[i] = view[i] >= 0 ? -1 : view[i] == MS_MINE ? 1 : view[i] == MS_SAFE ? 0
+              : (float) mines / covered;
+   return -1;
+}
+
+int ms_probabilities(const signed char *view, int width, int height, int mines, int threads, float *prob)
+{
+   int n = width * height;
+   signed char *state = (signed char *) malloc(n);
+   ms__solver s;
+   if (!state || ms__init(&s, view, width, height, state)) {
+      free(state);
+      return ms__probabilities_failed(view, n, mines, prob);
+   }
+   while (ms__local_rules(&s)) {}
+   if (threads < 1) threads = 1;
+
+   ms__prob_ctx ctx = { NULL, 0, 0, threads };
+   int failed = ms__components(&s, ms__collect_component, &ctx);
+   if (!failed) failed = ms__combine(&ctx, state, n, mines, prob);
+   if (failed < 0) ms__probabilities_failed(view, n, mines, prob);
+
+   for (int c = 0; c < ctx.num; c++) {
+      free(ctx.comps[c].cells);
+      free(ctx.comps[c].solutions);
+      free(ctx.comps[c].hits);
+   }
+   free(ctx.comps);
+   free(state);
+   ms__free(&s);
+   return failed;
+}
+
+// No-guess generation
+
+typedef struct
+{
+   int width, height, mines, x, y;
+   unsigned int seed;
+   pthread_mutex_t lock;
+   int done; // set once some worker has a board; read by the others to stop early
+   unsigned char *layout;
+} ms__gen_shared;
+
+typedef struct
+{
+   ms__gen_shared *shared;
+   unsigned int rng;
+   unsigned char *mine;  // this worker's layout
+   unsigned char *count; // neighbouring mines of each cell, kept up to date as mines move
+   signed char *view, *out;
+   int *queue;
+} ms__gen;
+
+static unsigned int ms__rand(unsigned int *state)
+{
+   // xorshift32
+   unsigned int v = *state;
+   v ^= v << 13;
+   v ^= v >> 17;
+   v ^= v << 5;
+   return *state = v;
+}
+
+static void ms__gen_set(ms__gen *g, int cell, int is_mine)
+{
+   int w = g->shared->width, h = g->shared->height;
+   int x = cell % w, y = cell / w;
+   g->mine[cell] = is_mine;
+   for (int k = 0; k < 8; k++) {
+      int nx = x + ms__dx[k], ny = y + ms__dy[k];
+      if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+      g->count[ny*w + nx] += is_mine ? 1 : -1;
+   }
+}
+
+static int ms__in_start_area(ms__gen_shared *sh, int cell)
+{
+   int x = cell % sh->width, y = cell / sh->width;
+   return x >= sh->x-1 && x <= sh->x+1 && y >= sh->y-1 && y <= sh->y+1;
+}
+
+static void ms__gen_layout(ms__gen *g)
+{
+   ms__gen_shared *sh = g->shared;
+   int n = sh->width * sh->height;
+   memset(g->mine, 0, n);
+   memset(g->count, 0, n);
+
+   // partial Fisher-Yates over every cell outside the start area
+   int *cells = g->queue, num = 0;
+   for (int i = 0; i < n; i++)
+      if (!ms__in_start_area(sh, i)) cells[num++] = i;
+   for (int i = 0; i < sh->mines && i < num; i++) {
+      int pick = i + ms__rand(&g->rng) % (num - i);
+      int cell = cells[pick];
+      cells[pick] = cells[i];
+      ms__gen_set(g, cell, 1);
+   }
+}
+
+// reveal a cell of the play-through, flooding out from zeros; returns the number of cells revealed
+static int ms__gen_reveal(ms__gen *g, int cell)
+{
+   int w = g->shared->width, h = g->shared->height;
+   int head = 0, tail = 0;
+   g->view[cell] = g->count[cell];
+   g->queue[tail++] = cell;
+   while (head < tail) {
+      int c = g->queue[head++];
+      if (g->count[c]) continue;
+      int x = c % w, y = c / w;
+      for (int k = 0; k < 8; k++) {
+         int nx = x + ms__dx[k], ny = y + ms__dy[k];
+         if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+         int nc = ny*w + nx;
+         if (g->view[nc] >= 0) continue;
+         g->view[nc] = g->count[nc];
+         g->queue[tail++] = nc;
+      }
+   }
+   return tail;
+}
+
+// play the current layout with the solver alone; returns 1 if that clears the board
+static int ms__gen_play(ms__gen *g)
+{
+   ms__gen_shared *sh = g->shared;
+   int n = sh->width * sh->height;
+   memset(g->view, MS_UNKNOWN, n);
+   int revealed = ms__gen_reveal(g, sh->y*sh->width + sh->x);
+
+   while (revealed < n - sh->mines) {
+      if (ms_solve(g->view, sh->width, sh->height, sh->mines, g->out) <= 0) return 0;
+      int progress = 0;
+      for (int i = 0; i < n; i++) {
+         if (g->out[i] == MS_MINE) g->view[i] = MS_MINE;
+         else if (g->out[i] == MS_SAFE && g->view[i] < 0) {
+            revealed += ms__gen_reveal(g, i);
+            progress = 1;
+         }
+      }
+      if (!progress) return 0;
+   }
+   return 1;
+}
+
+// Move one mine off the frontier where the play-through got stuck to a covered cell away from it.
+// Returns 0 if there is nowhere to move it.
+static int ms__gen_nudge(ms__gen *g)
+{
+   ms__gen_shared *sh = g->shared;
+   int w = sh->width, h = sh->height, n = w * h;
+   int *frontier = g->queue, num_frontier = 0;
+   int num_away = 0;
+
+   for (int i = 0; i < n; i++) {
+      if (g->view[i] != MS_UNKNOWN) continue;
+      int x = i % w, y = i / w, edge = 0;
+      for (int k = 0; k < 8 && !edge; k++) {
+         int nx = x + ms__dx[k], ny = y + ms__dy[k];
+         if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+         edge = g->view[ny*w + nx] >= 0;
+      }
+      if (edge) {
+         if (g->mine[i]) frontier[num_frontier++] = i;
+      } else if (!g->mine[i]) {
+         num_away++;
+      }
+   }
+   if (num_frontier == 0 || num_away == 0) return 0;
+
+   int from = frontier[ms__rand(&g->rng) % num_frontier];
+   int to = ms__rand(&g->rng) % num_away;
+   for (int i = 0; i < n; i++) {
+      if (g->view[i] != MS_UNKNOWN || g->mine[i]) continue;
+      int x = i % w, y = i / w, edge = 0;
+      for (int k = 0; k < 8 && !edge; k++) {
+         int nx = x + ms__dx[k], ny = y + ms__dy[k];
+         if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+         edge = g->view[ny*w + nx] >= 0;
+      }
+      if (!edge && to-- == 0) {
+         ms__gen_set(g, from, 0);
+         ms__gen_set(g, i, 1);
+         return 1;
+      }
+   }
+   return 0;
+}
+
+static void *ms__gen_worker(void *arg)
+{
+   ms__gen *g = (ms__gen *) arg;
+   ms__gen_shared *sh = g->shared;
+   int n = sh->width * sh->height;
+
+   for (int plays = 0; plays < MS_GEN_BUDGET && !__atomic_load_n(&sh->done, __ATOMIC_RELAXED); ) {
+      ms__gen_layout(g);
+      for (int moves = 0; moves <= MS_GEN_MOVES && plays < MS_GEN_BUDGET; moves++, plays++) {
+         if (ms__gen_play(g)) {
+            pthread_mutex_lock(&sh->lock);
+            if (!sh->done) memcpy(sh->layout, g->mine, n);
+            __atomic_store_n(&sh->done, 1, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&sh->lock);
+            return NULL;
+         }
+         if (__atomic_load_n(&sh->done, __ATOMIC_RELAXED) || !ms__gen_nudge(g)) break;
+      }
+   }
+   return NULL;
+}
+
+int ms_generate_noguess(int width, int height, int mines, int x, int y,
+                        unsigned int seed, int threads, unsigned char *layout)
+{
+   int n = width * height;
+   if (threads < 1) threads = 1;
+
+   ms__gen_shared sh = { .width = width, .height = height, .mines = mines, .x = x, .y = y,
+                         .seed = seed, .done = 0, .layout = layout };
+   int outside = 0;
+   for (int i = 0; i < n; i++)
+      if (!ms__in_start_area(&sh, i)) outside++;
+   if (mines > outside) return 1;
+
+   ms__gen *gens = (ms__gen *) calloc(threads, sizeof(ms__gen));
+   pthread_t *tids = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+   char *started = (char *) calloc(threads, 1);
+   int failed = !gens || !tids || !started;
+   for (int t = 0; t < threads && !failed; t++) {
+      ms__gen *g = &gens[t];
+      g->shared = &sh;
+      g->rng = (seed ^ (0x9e3779b9u * (t+1))) | 1;
+      g->mine = (unsigned char *) malloc(n);
+      g->count = (unsigned char *) malloc(n);
+      g->view = (signed char *) malloc(n);
+      g->out = (signed char *) malloc(n);
+      g->queue = (int *) malloc(sizeof(int) * n);
+      failed = !g->mine || !g->count || !g->view || !g->out || !g->queue;
+   }
+
+   if (!failed) {
+      pthread_mutex_init(&sh.lock, NULL);
+      // the calling thread is worker 0
+      for (int t = 1; t < threads; t++)
+         started[t] = !pthread_create(&tids[t], NULL, ms__gen_worker, &gens[t]);
+      ms__gen_worker(&gens[0]);
+      for (int t = 1; t < threads; t++)
+         if (started[t]) pthread_join(tids[t], NULL);
+      pthread_mutex_destroy(&sh.lock);
+   }
+
+   for (int t = 0; gens && t < threads; t++) {
+      free(gens[t].mine); free(gens[t].count);
+      free(gens[t].view); free(gens[t].out); free(gens[t].queue);
+   }
+   free(gens);
+   free(tids);
+   free(started);
+   return failed || !sh.done;
+}
+
+#endif // MS_SOLVER_IMPLEMENTATION
@@ -41,8 +41,57 @@
 //                                int   seed)
 //
 // As above, but 'seed' selects from multiple different variations of the
-// noise function. The current implementation only uses the bottom 8 bits
-// of 'seed', but possibly in the future more bits will be used.
+// noise function. All 32 bits of 'seed' are used. Seeds 0-255 give the
+// same noise they always have. Any other seed gets its own permutation
+// table, shuffled from a hash of the seed. The tables are kept in a
+// small per-thread cache (STB_PERLIN_SEED_CACHE entries, default 8,
+// about 1KB each) with the least recently used one evicted. Switching
+// between a few seeds costs nothing after the first call with each one.
+//
+// float  stb_perlin_noise2( float x,
+//                           float y,
+//                           int   x_wrap=0,
+//                           int   y_wrap=0)
+//
+// float  stb_perlin_noise2_seed( float x,
+//                                float y,
+//                                int   x_wrap=0,
+//                                int   y_wrap=0,
+//                                int   seed)
+//
+// The same noise as stb_perlin_noise3/stb_perlin_noise3_seed at z=0
+// (with z_wrap=0), bit for bit, but only interpolating the 4 corners
+// of the square (x,y) is in rather than 8 of a cube. Use these
+// whenever z would be fixed at 0 anyway.
+//
+// float  stb_perlin_noise3_wrap_nonpow2( float x,
+//                                        float y,
+//                                        float z,
+//                                        int   x_wrap,
+//                                        int   y_wrap,
+//                                        int   z_wrap,
+//                                        unsigned char seed)
+//
+// As stb_perlin_noise3_seed, but the wrap periods can be any size up to
+// 256, not just powers of two (0 still means 256).
+//
+// void   stb_perlin_noise3_wrap_nonpow2_row( float *out,
+//                                            int   count,
+//                                            float x,
+//                                            float dx,
+//                                            float y,
+//                                            float z,
+//                                            int   x_wrap,
+//                                            int   y_wrap,
+//                                            int   z_wrap,
+//                                            unsigned char seed)
+//
+// Fills out[i] for i = 0..count-1 with exactly what
+// stb_perlin_noise3_wrap_nonpow2(x + i*dx, y, z, ...) returns, with
+// x + i*dx evaluated in float as x + (float)i*dx. For rendering tiles:
+// the y and z wrapping is worked out once per row, and the x lattice
+// cell is stepped along as the samples cross into the next one, so
+// there's no division per sample.
 //
 //
 // Fractal Noise:
@@ -68,6 +117,33 @@
 //     offset     =   1.0?  -- used to invert the ridges, may need to be larger, not sure
 //
 //
+// Derivatives:
+//
+// float stb_perlin_noise3_deriv(float x, float y, float z,
+//                               int x_wrap, int y_wrap, int z_wrap, float grad[3])
+//
+// float stb_perlin_noise3_seed_deriv(float x, float y, float z,
+//                                    int x_wrap, int y_wrap, int z_wrap, int seed, float grad[3])
+//
+// float stb_perlin_ridge_noise3_deriv(float x, float y, float z, float lacunarity,
+//                                     float gain, float offset, int octaves, float grad[3])
+//
+// float stb_perlin_fbm_noise3_deriv(float x, float y, float z, float lacunarity,
+//                                   float gain, int octaves, float grad[3])
+//
+// float stb_perlin_turbulence_noise3_deriv(float x, float y, float z, float lacunarity,
+//                                          float gain, int octaves, float grad[3])
+//
+// Each returns exactly what the function without _deriv returns, and
+// also stores the analytic partial derivatives d/dx, d/dy and d/dz of
+// that value in grad[0..2]. They're worked out from the same 8 corners
+// in the same pass, so this is much cheaper than finite differences
+// (which take 4 evaluations) and has no step size to pick. For normal
+// maps and lighting. The ridge and turbulence gradients are taken as 0
+// on the creases where a noise octave is exactly 0, where they're not
+// defined.
+//
+//
 // Contributors:
 //    Jack Mott - additional noise functions
 //    Jordan Peck - seeded noise
@@ -79,10 +155,18 @@ extern "C" {
 #endif
 extern float stb_perlin_noise3(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap);
 extern float stb_perlin_noise3_seed(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, int seed);
+extern float stb_perlin_noise2(float x, float y, int x_wrap, int y_wrap);
+extern float stb_perlin_noise2_seed(float x, float y, int x_wrap, int y_wrap, int seed);
 extern float stb_perlin_ridge_noise3(float x, float y, float z, float lacunarity, float gain, float offset, int octaves);
 extern float stb_perlin_fbm_noise3(float x, float y, float z, float lacunarity, float gain, int octaves);
 extern float stb_perlin_turbulence_noise3(float x, float y, float z, float lacunarity, float gain, int octaves);
+extern float stb_perlin_noise3_deriv(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, float grad[3]);
+extern float stb_perlin_noise3_seed_deriv(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, int seed, float grad[3]);
+extern float stb_perlin_ridge_noise3_deriv(float x, float y, float z, float lacunarity, float gain, float offset, int octaves, float grad[3]);
+extern float stb_perlin_fbm_noise3_deriv(float x, float y, float z, float lacunarity, float gain, int octaves, float grad[3]);
+extern float stb_perlin_turbulence_noise3_deriv(float x, float y, float z, float lacunarity, float gain, int octaves, float grad[3]);
 extern float stb_perlin_noise3_wrap_nonpow2(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, unsigned char seed);
+extern void  stb_perlin_noise3_wrap_nonpow2_row(float *out, int count, float x, float dx, float y, float z, int x_wrap, int y_wrap, int z_wrap, unsigned char seed);
 #ifdef __cplusplus
 }
 #endif
@@ -91,6 +175,20 @@ extern float stb_perlin_noise3_wrap_nonpow2(float x, float y, float z, int x_wra
 
 #include <math.h> // fabs()
 
+#ifndef STB_PERLIN_SEED_CACHE
+#define STB_PERLIN_SEED_CACHE 8
+#endif
+
+#ifndef STB_PERLIN_THREAD_LOCAL
+   #if defined(_MSC_VER)
+      #define STB_PERLIN_THREAD_LOCAL __declspec(thread)
+   #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STB_PERLIN_THREAD_LOCAL _Thread_local
+   #else
+      #define STB_PERLIN_THREAD_LOCAL __thread
+   #endif
+#endif
+
 // not same permutation table as Perlin's reference to avoid copyright issues;
 // Perlin's table can be found at http://mrl.nyu.edu/~perlin/noise/
 static unsigned char stb__perlin_randtab[512] =
@@ -176,6 +274,105 @@ static unsigned char stb__perlin_randtab_grad_idx[512] =
     9, 0, 11, 5, 10, 3, 2, 3, 5, 9, 7, 9, 8, 4, 6, 5,
 };
 
+// The three tables one evaluation looks through: the x corner hashes through xtab, then the y
+// corner through ytab, then the z corner picks a gradient from gtab. For seeds 0-255, xtab is
+// randtab offset by the seed and the others are the shared tables, which is the noise as it has
+// always been. Other seeds use a shuffled permutation for both xtab and ytab.
+typedef struct
+{
+   const unsigned char *xtab, *ytab, *gtab;
+} stb__perlin_tables;
+
+// the stock tables for one of the 256 original seeds, which is all the octaves of the fractal
+// functions use
+static stb__perlin_tables stb__perlin_byte_tables(unsigned char seed)
+{
+   stb__perlin_tables tabs;
+   tabs.xtab = stb__perlin_randtab + seed;
+   tabs.ytab = stb__perlin_randtab;
+   tabs.gtab = stb__perlin_randtab_grad_idx;
+   return tabs;
+}
+
+typedef struct
+{
+   unsigned int seed;
+   unsigned int last_used;   // 0 for an empty slot
+   unsigned char perm[512];
+   unsigned char grad_idx[512];
+} stb__perlin_seed_table;
+
+static void stb__perlin_build_seed_table(stb__perlin_seed_table *t, unsigned int seed)
+{
+   unsigned char grad_of[256];
+   unsigned int h = seed;
+   int i;
+
+   // the gradient for each randtab value, so a shuffled permutation gets the same mix of
+   // gradients as the stock table
+   for (i = 0; i < 256; i++)
+      grad_of[stb__perlin_randtab[i]] = stb__perlin_randtab_grad_idx[i];
+
+   for (i = 0; i < 256; i++)
+      t->perm[i] = (unsigned char) i;
+   for (i = 255; i > 0; i--) {
+      unsigned int j;
+      unsigned char tmp;
+      // murmur3's finalizer over a Weyl sequence
+      h += 0x9e3779b9u;
+      j = h;
+      j ^= j >> 16; j *= 0x85ebca6bu;
+      j ^= j >> 13; j *= 0xc2b2ae35u;
+      j ^= j >> 16;
+      j = (unsigned int) (((unsigned long long) j * (unsigned int) (i+1)) >> 32);
+      tmp = t->perm[i]; t->perm[i] = t->perm[j]; t->perm[j] = tmp;
+   }
+   for (i = 0; i < 256; i++) {
+      t->perm[i+256] = t->perm[i];
+      t->grad_idx[i] = t->grad_idx[i+256] = grad_of[t->perm[i]];
+   }
+   t->seed = seed;
+}
+
+static stb__perlin_tables stb__perlin_get_tables(int seed)
+{
+   static STB_PERLIN_THREAD_LOCAL stb__perlin_seed_table cache[STB_PERLIN_SEED_CACHE];
+   static STB_PERLIN_THREAD_LOCAL stb__perlin_seed_table *recent;
+   static STB_PERLIN_THREAD_LOCAL unsigned int tick;
+   stb__perlin_tables tabs;
+   stb__perlin_seed_table *t = recent;
+   unsigned int useed = (unsigned int) seed;
+
+   if (useed < 256)
+      return stb__perlin_byte_tables((unsigned char) useed);
+
+   if (!t || t->seed != useed) {
+      int i;
+      stb__perlin_seed_table *oldest = &cache[0];
+      t = 0;
+      for (i = 0; i < STB_PERLIN_SEED_CACHE; i++) {
+         if (cache[i].last_used && cache[i].seed == useed) { t = &cache[i]; break; }
+         if (cache[i].last_used < oldest->last_used) oldest = &cache[i];
+      }
+      if (!t) {
+         t = oldest;
+         stb__perlin_build_seed_table(t, useed);
+      }
+      if (++tick == 0) {
+         // wrapped after 4 billion switches; start the ages again
+         for (i = 0; i < STB_PERLIN_SEED_CACHE; i++)
+            if (cache[i].last_used) cache[i].last_used = 1;
+         tick = 2;
+      }
+      t->last_used = tick;
+      recent = t;
+   }
+   tabs.xtab = t->perm;
+   tabs.ytab = t->perm;
+   tabs.gtab = t->grad_idx;
+   return tabs;
+}
+
 static float stb__perlin_lerp(float a, float b, float t)
 {
    return a + (b-a) * t;
@@ -210,7 +407,7 @@ static float stb__perlin_grad(int grad_idx, float x, float y, float z)
    return grad[0]*x + grad[1]*y + grad[2]*z;
 }
 
-float stb_perlin_noise3_internal(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, unsigned char seed)
+static float stb__perlin_noise3_tabs(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, stb__perlin_tables tabs)
 {
    float u,v,w;
    float n000,n001,n010,n011,n100,n101,n110,n111;
@@ -234,22 +431,22 @@ float stb_perlin_noise3_internal(float x, float y, float z, int x_wrap, int y_wr
    y -= py; v = stb__perlin_ease(y);
    z -= pz; w = stb__perlin_ease(z);
 
-   r0 = stb__perlin_randtab[x0+seed];
-   r1 = stb__perlin_randtab[x1+seed];
+   r0 = tabs.xtab[x0];
+   r1 = tabs.xtab[x1];
 
-   r00 = stb__perlin_randtab[r0+y0];
-   r01 = stb__perlin_randtab[r0+y1];
-   r10 = stb__perlin_randtab[r1+y0];
-   r11 = stb__perlin_randtab[r1+y1];
+   r00 = tabs.ytab[r0+y0];
+   r01 = tabs.ytab[r0+y1];
+   r10 = tabs.ytab[r1+y0];
+   r11 = tabs.ytab[r1+y1];
 
-   n000 = stb__perlin_grad(stb__perlin_randtab_grad_idx[r00+z0], x  , y  , z   );
-   n001 = stb__perlin_grad(stb__perlin_randtab_grad_idx[r00+z1], x  , y  , z-1 );
-   n010 = stb__perlin_grad(stb__perlin_randtab_grad_idx[r01+z0], x  , y-1, z   );
-   n011 = stb__perlin_grad(stb__perlin_randtab_grad_idx[r01+z1], x  , y-1, z-1 );
-   n100 = stb__perlin_grad(stb__perlin_randtab_grad_idx[r10+z0], x-1, y  , z   );
-   n101 = stb__perlin_grad(stb__perlin_randtab_grad_idx[r10+z1], x-1, y  , z-1 );
-   n110 = stb__perlin_grad(stb__perlin_randtab_grad_idx[r11+z0], x-1, y-1, z   );
-   n111 = stb__perlin_grad(stb__perlin_randtab_grad_idx[r11+z1], x-1, y-1, z-1 );
+   n000 = stb__perlin_grad(tabs.gtab[r00+z0], x  , y  , z   );
+   n001 = stb__perlin_grad(tabs.gtab[r00+z1], x  , y  , z-1 );
+   n010 = stb__perlin_grad(tabs.gtab[r01+z0], x  , y-1, z   );
+   n011 = stb__perlin_grad(tabs.gtab[r01+z1], x  , y-1, z-1 );
+   n100 = stb__perlin_grad(tabs.gtab[r10+z0], x-1, y  , z   );
+   n101 = stb__perlin_grad(tabs.gtab[r10+z1], x-1, y  , z-1 );
+   n110 = stb__perlin_grad(tabs.gtab[r11+z0], x-1, y-1, z   );
+   n111 = stb__perlin_grad(tabs.gtab[r11+z1], x-1, y-1, z-1 );
 
    n00 = stb__perlin_lerp(n000,n001,w);
    n01 = stb__perlin_lerp(n010,n011,w);
@@ -262,6 +459,11 @@ float stb_perlin_noise3_internal(float x, float y, float z, int x_wrap, int y_wr
    return stb__perlin_lerp(n0,n1,u);
 }
 
+float stb_perlin_noise3_internal(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, unsigned char seed)
+{
+    return stb__perlin_noise3_tabs(x,y,z,x_wrap,y_wrap,z_wrap, stb__perlin_byte_tables(seed));
+}
+
 float stb_perlin_noise3(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap)
 {
     return stb_perlin_noise3_internal(x,y,z,x_wrap,y_wrap,z_wrap,0);
@@ -269,7 +471,65 @@ float stb_perlin_noise3(float x, float y, float z, int x_wrap, int y_wrap, int z
 
 float stb_perlin_noise3_seed(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, int seed)
 {
-    return stb_perlin_noise3_internal(x,y,z,x_wrap,y_wrap,z_wrap, (unsigned char) seed);
+    return stb__perlin_noise3_tabs(x,y,z,x_wrap,y_wrap,z_wrap, stb__perlin_get_tables(seed));
+}
+
+// The z=0 face of the cube stb_perlin_noise3_internal interpolates: its z0 corner is at
+// gtab[r], its z1 corner at gtab[r+1], and the z ease is exactly 0. Lerping towards the
+// z1 corner by 0 leaves any nonzero value alone and can only flip the sign of a zero, so the z1
+// corner is only looked at then, to keep the result bit-identical to the 3D function.
+static float stb__perlin_grad_z0(const unsigned char *gtab, int r, float x, float y)
+{
+   float n = stb__perlin_grad(gtab[r], x, y, 0.0f);
+   if (n == 0)
+      n = stb__perlin_lerp(n, stb__perlin_grad(gtab[r+1], x, y, -1.0f), 0.0f);
+   return n;
+}
+
+static float stb__perlin_noise2_tabs(float x, float y, int x_wrap, int y_wrap, stb__perlin_tables tabs)
+{
+   float u,v;
+   float n00,n01,n10,n11;
+   float n0,n1;
+
+   unsigned int x_mask = (x_wrap-1) & 255;
+   unsigned int y_mask = (y_wrap-1) & 255;
+   int px = stb__perlin_fastfloor(x);
+   int py = stb__perlin_fastfloor(y);
+   int x0 = px & x_mask, x1 = (px+1) & x_mask;
+   int y0 = py & y_mask, y1 = (py+1) & y_mask;
+   int r0,r1;
+
+   x -= px; u = stb__perlin_ease(x);
+   y -= py; v = stb__perlin_ease(y);
+
+   r0 = tabs.xtab[x0];
+   r1 = tabs.xtab[x1];
+
+   n00 = stb__perlin_grad_z0(tabs.gtab, tabs.ytab[r0+y0], x  , y  );
+   n01 = stb__perlin_grad_z0(tabs.gtab, tabs.ytab[r0+y1], x  , y-1);
+   n10 = stb__perlin_grad_z0(tabs.gtab, tabs.ytab[r1+y0], x-1, y  );
+   n11 = stb__perlin_grad_z0(tabs.gtab, tabs.ytab[r1+y1], x-1, y-1);
+
+   n0 = stb__perlin_lerp(n00,n01,v);
+   n1 = stb__perlin_lerp(n10,n11,v);
+
+   return stb__perlin_lerp(n0,n1,u);
+}
+
+float stb_perlin_noise2_internal(float x, float y, int x_wrap, int y_wrap, unsigned char seed)
+{
+    return stb__perlin_noise2_tabs(x,y,x_wrap,y_wrap, stb__perlin_byte_tables(seed));
+}
+
+float stb_perlin_noise2(float x, float y, int x_wrap, int y_wrap)
+{
+    return stb_perlin_noise2_internal(x,y,x_wrap,y_wrap,0);
+}
+
+float stb_perlin_noise2_seed(float x, float y, int x_wrap, int y_wrap, int seed)
+{
+    return stb__perlin_noise2_tabs(x,y,x_wrap,y_wrap, stb__perlin_get_tables(seed));
 }
 
 float stb_perlin_ridge_noise3(float x, float y, float z, float lacunarity, float gain, float offset, int octaves)
@@ -323,6 +583,177 @@ float stb_perlin_turbulence_noise3(float x, float y, float z, float lacunarity,
    return sum;
 }
 
+// As stb_perlin_noise3_internal, carrying d/dx, d/dy and d/dz along with each lerp. The value is
+// computed by the same expressions in the same order, so it stays bit-identical.
+static float stb__perlin_noise3_tabs_deriv(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, stb__perlin_tables tabs, float grad[3])
+{
+   static signed char basis[12][3] =
+   {
+      {  1, 1, 0 }, { -1, 1, 0 }, {  1,-1, 0 }, { -1,-1, 0 },
+      {  1, 0, 1 }, { -1, 0, 1 }, {  1, 0,-1 }, { -1, 0,-1 },
+      {  0, 1, 1 }, {  0,-1, 1 }, {  0, 1,-1 }, {  0,-1,-1 },
+   };
+   float u,v,w, du,dv,dw;
+   float n000,n001,n010,n011,n100,n101,n110,n111;
+   float n00,n01,n10,n11;
+   float n0,n1;
+   float n00x,n00y,n00z, n01x,n01y,n01z, n10x,n10y,n10z, n11x,n11y,n11z;
+   float n0x,n0y,n0z, n1x,n1y,n1z;
+   signed char *g000,*g001,*g010,*g011,*g100,*g101,*g110,*g111;
+
+   unsigned int x_mask = (x_wrap-1) & 255;
+   unsigned int y_mask = (y_wrap-1) & 255;
+   unsigned int z_mask = (z_wrap-1) & 255;
+   int px = stb__perlin_fastfloor(x);
+   int py = stb__perlin_fastfloor(y);
+   int pz = stb__perlin_fastfloor(z);
+   int x0 = px & x_mask, x1 = (px+1) & x_mask;
+   int y0 = py & y_mask, y1 = (py+1) & y_mask;
+   int z0 = pz & z_mask, z1 = (pz+1) & z_mask;
+   int r0,r1, r00,r01,r10,r11;
+
+   #define stb__perlin_ease_deriv(a)   (30 * a * a * (a*(a-2) + 1))
+
+   x -= px; u = stb__perlin_ease(x); du = stb__perlin_ease_deriv(x);
+   y -= py; v = stb__perlin_ease(y); dv = stb__perlin_ease_deriv(y);
+   z -= pz; w = stb__perlin_ease(z); dw = stb__perlin_ease_deriv(z);
+
+   r0 = tabs.xtab[x0];
+   r1 = tabs.xtab[x1];
+
+   r00 = tabs.ytab[r0+y0];
+   r01 = tabs.ytab[r0+y1];
+   r10 = tabs.ytab[r1+y0];
+   r11 = tabs.ytab[r1+y1];
+
+   g000 = basis[tabs.gtab[r00+z0]];
+   g001 = basis[tabs.gtab[r00+z1]];
+   g010 = basis[tabs.gtab[r01+z0]];
+   g011 = basis[tabs.gtab[r01+z1]];
+   g100 = basis[tabs.gtab[r10+z0]];
+   g101 = basis[tabs.gtab[r10+z1]];
+   g110 = basis[tabs.gtab[r11+z0]];
+   g111 = basis[tabs.gtab[r11+z1]];
+
+   n000 = stb__perlin_grad(tabs.gtab[r00+z0], x  , y  , z   );
+   n001 = stb__perlin_grad(tabs.gtab[r00+z1], x  , y  , z-1 );
+   n010 = stb__perlin_grad(tabs.gtab[r01+z0], x  , y-1, z   );
+   n011 = stb__perlin_grad(tabs.gtab[r01+z1], x  , y-1, z-1 );
+   n100 = stb__perlin_grad(tabs.gtab[r10+z0], x-1, y  , z   );
+   n101 = stb__perlin_grad(tabs.gtab[r10+z1], x-1, y  , z-1 );
+   n110 = stb__perlin_grad(tabs.gtab[r11+z0], x-1, y-1, z   );
+   n111 = stb__perlin_grad(tabs.gtab[r11+z1], x-1, y-1, z-1 );
+
+   // each corner's value is linear with the corner's gradient as its slope; only the lerp weight
+   // along z depends on z, so only the z derivative picks up the ease term
+   n00 = stb__perlin_lerp(n000,n001,w);
+   n01 = stb__perlin_lerp(n010,n011,w);
+   n10 = stb__perlin_lerp(n100,n101,w);
+   n11 = stb__perlin_lerp(n110,n111,w);
+   n00x = stb__perlin_lerp(g000[0],g001[0],w); n00y = stb__perlin_lerp(g000[1],g001[1],w); n00z = stb__perlin_lerp(g000[2],g001[2],w) + dw*(n001-n000);
+   n01x = stb__perlin_lerp(g010[0],g011[0],w); n01y = stb__perlin_lerp(g010[1],g011[1],w); n01z = stb__perlin_lerp(g010[2],g011[2],w) + dw*(n011-n010);
+   n10x = stb__perlin_lerp(g100[0],g101[0],w); n10y = stb__perlin_lerp(g100[1],g101[1],w); n10z = stb__perlin_lerp(g100[2],g101[2],w) + dw*(n101-n100);
+   n11x = stb__perlin_lerp(g110[0],g111[0],w); n11y = stb__perlin_lerp(g110[1],g111[1],w); n11z = stb__perlin_lerp(g110[2],g111[2],w) + dw*(n111-n110);
+
+   n0 = stb__perlin_lerp(n00,n01,v);
+   n1 = stb__perlin_lerp(n10,n11,v);
+   n0x = stb__perlin_lerp(n00x,n01x,v); n0y = stb__perlin_lerp(n00y,n01y,v) + dv*(n01-n00); n0z = stb__perlin_lerp(n00z,n01z,v);
+   n1x = stb__perlin_lerp(n10x,n11x,v); n1y = stb__perlin_lerp(n10y,n11y,v) + dv*(n11-n10); n1z = stb__perlin_lerp(n10z,n11z,v);
+
+   grad[0] = stb__perlin_lerp(n0x,n1x,u) + du*(n1-n0);
+   grad[1] = stb__perlin_lerp(n0y,n1y,u);
+   grad[2] = stb__perlin_lerp(n0z,n1z,u);
+   return stb__perlin_lerp(n0,n1,u);
+}
+
+float stb_perlin_noise3_internal_deriv(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, unsigned char seed, float grad[3])
+{
+    return stb__perlin_noise3_tabs_deriv(x,y,z,x_wrap,y_wrap,z_wrap, stb__perlin_byte_tables(seed), grad);
+}
+
+float stb_perlin_noise3_deriv(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, float grad[3])
+{
+    return stb_perlin_noise3_internal_deriv(x,y,z,x_wrap,y_wrap,z_wrap,0,grad);
+}
+
+float stb_perlin_noise3_seed_deriv(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, int seed, float grad[3])
+{
+    return stb__perlin_noise3_tabs_deriv(x,y,z,x_wrap,y_wrap,z_wrap, stb__perlin_get_tables(seed), grad);
+}
+
+float stb_perlin_ridge_noise3_deriv(float x, float y, float z, float lacunarity, float gain, float offset, int octaves, float grad[3])
+{
+   int i;
+   float frequency = 1.0f;
+   float prev = 1.0f;
+   float amplitude = 0.5f;
+   float sum = 0.0f;
+   float dprev[3] = { 0, 0, 0 };
+   float d[3];
+
+   grad[0] = grad[1] = grad[2] = 0;
+   for (i = 0; i < octaves; i++) {
+      float r = stb_perlin_noise3_internal_deriv(x*frequency,y*frequency,z*frequency,0,0,0,(unsigned char)i,d);
+      // d(offset-|n|)^2 = -2*(offset-|n|)*sign(n)*dn, with dn scaled by the octave's frequency
+      float s = -2 * (offset - (float) fabs(r)) * (r > 0 ? frequency : r < 0 ? -frequency : 0);
+      int k;
+      r = offset - (float) fabs(r);
+      r = r*r;
+      sum += r*amplitude*prev;
+      for (k = 0; k < 3; k++) {
+         d[k] *= s;
+         grad[k] += amplitude*(d[k]*prev + r*dprev[k]);
+         dprev[k] = d[k];
+      }
+      prev = r;
+      frequency *= lacunarity;
+      amplitude *= gain;
+   }
+   return sum;
+}
+
+float stb_perlin_fbm_noise3_deriv(float x, float y, float z, float lacunarity, float gain, int octaves, float grad[3])
+{
+   int i;
+   float frequency = 1.0f;
+   float amplitude = 1.0f;
+   float sum = 0.0f;
+   float d[3];
+
+   grad[0] = grad[1] = grad[2] = 0;
+   for (i = 0; i < octaves; i++) {
+      sum += stb_perlin_noise3_internal_deriv(x*frequency,y*frequency,z*frequency,0,0,0,(unsigned char)i,d)*amplitude;
+      grad[0] += d[0]*amplitude*frequency;
+      grad[1] += d[1]*amplitude*frequency;
+      grad[2] += d[2]*amplitude*frequency;
+      frequency *= lacunarity;
+      amplitude *= gain;
+   }
+   return sum;
+}
+
+float stb_perlin_turbulence_noise3_deriv(float x, float y, float z, float lacunarity, float gain, int octaves, float grad[3])
+{
+   int i;
+   float frequency = 1.0f;
+   float amplitude = 1.0f;
+   float sum = 0.0f;
+   float d[3];
+
+   grad[0] = grad[1] = grad[2] = 0;
+   for (i = 0; i < octaves; i++) {
+      float r = stb_perlin_noise3_internal_deriv(x*frequency,y*frequency,z*frequency,0,0,0,(unsigned char)i,d)*amplitude;
+      float s = r > 0 ? amplitude*frequency : r < 0 ? -amplitude*frequency : 0;
+      sum += (float) fabs(r);
+      grad[0] += d[0]*s;
+      grad[1] += d[1]*s;
+      grad[2] += d[2]*s;
+      frequency *= lacunarity;
+      amplitude *= gain;
+   }
+   return sum;
+}
+
 float stb_perlin_noise3_wrap_nonpow2(float x, float y, float z, int x_wrap, int y_wrap, int z_wrap, unsigned char seed)
 {
    float u,v,w;
@@ -383,6 +814,85 @@ float stb_perlin_noise3_wrap_nonpow2(float x, float y, float z, int x_wrap, int
 
    return stb__perlin_lerp(n0,n1,u);
 }
+
+void stb_perlin_noise3_wrap_nonpow2_row(float *out, int count, float x, float dx, float y, float z, int x_wrap, int y_wrap, int z_wrap, unsigned char seed)
+{
+   int i;
+   int x_wrap2 = (x_wrap ? x_wrap : 256);
+   int y_wrap2 = (y_wrap ? y_wrap : 256);
+   int z_wrap2 = (z_wrap ? z_wrap : 256);
+
+   // y and z are the same for the whole row
+   int py = stb__perlin_fastfloor(y);
+   int pz = stb__perlin_fastfloor(z);
+   int y0 = py % y_wrap2, y1;
+   int z0 = pz % z_wrap2, z1;
+   float v,w;
+
+   // the current x lattice cell, and everything that depends only on it
+   int have_cell = 0, cell_px = 0, x0 = 0, x1 = 0;
+   int g000=0,g001=0,g010=0,g011=0,g100=0,g101=0,g110=0,g111=0;
+
+   if (y0 < 0) y0 += y_wrap2;
+   if (z0 < 0) z0 += z_wrap2;
+   y1 = (y0+1) % y_wrap2;
+   z1 = (z0+1) % z_wrap2;
+
+   y -= py; v = stb__perlin_ease(y);
+   z -= pz; w = stb__perlin_ease(z);
+
+   for (i = 0; i < count; i++) {
+      float xs = x + (float)i*dx;
+      int px = stb__perlin_fastfloor(xs);
+      float u, n00,n01,n10,n11, n0,n1;
+
+      if (!have_cell || px != cell_px) {
+         int r0,r1, r00,r01,r10,r11;
+         if (have_cell && px == cell_px+1) {
+            // stepped into the next cell, which is the usual case when dx < 1
+            x0 = x1;
+            x1 = (x0+1 == x_wrap2) ? 0 : x0+1;
+         } else {
+            x0 = px % x_wrap2;
+            if (x0 < 0) x0 += x_wrap2;
+            x1 = (x0+1 == x_wrap2) ? 0 : x0+1;
+         }
+         have_cell = 1;
+         cell_px = px;
+
+         r0 = stb__perlin_randtab[x0];
+         r0 = stb__perlin_randtab[r0+seed];
+         r1 = stb__perlin_randtab[x1];
+         r1 = stb__perlin_randtab[r1+seed];
+
+         r00 = stb__perlin_randtab[r0+y0];
+         r01 = stb__perlin_randtab[r0+y1];
+         r10 = stb__perlin_randtab[r1+y0];
+         r11 = stb__perlin_randtab[r1+y1];
+
+         g000 = stb__perlin_randtab_grad_idx[r00+z0];
+         g001 = stb__perlin_randtab_grad_idx[r00+z1];
+         g010 = stb__perlin_randtab_grad_idx[r01+z0];
+         g011 = stb__perlin_randtab_grad_idx[r01+z1];
+         g100 = stb__perlin_randtab_grad_idx[r10+z0];
+         g101 = stb__perlin_randtab_grad_idx[r10+z1];
+         g110 = stb__perlin_randtab_grad_idx[r11+z0];
+         g111 = stb__perlin_randtab_grad_idx[r11+z1];
+      }
+
+      xs -= px; u = stb__perlin_ease(xs);
+
+      n00 = stb__perlin_lerp(stb__perlin_grad(g000, xs  , y  , z  ), stb__perlin_grad(g001, xs  , y  , z-1), w);
+      n01 = stb__perlin_lerp(stb__perlin_grad(g010, xs  , y-1, z  ), stb__perlin_grad(g011, xs  , y-1, z-1), w);
+      n10 = stb__perlin_lerp(stb__perlin_grad(g100, xs-1, y  , z  ), stb__perlin_grad(g101, xs-1, y  , z-1), w);
+      n11 = stb__perlin_lerp(stb__perlin_grad(g110, xs-1, y-1, z  ), stb__perlin_grad(g111, xs-1, y-1, z-1), w);
+
+      n0 = stb__perlin_lerp(n00,n01,v);
+      n1 = stb__perlin_lerp(n10,n11,v);
+
+      out[i] = stb__perlin_lerp(n0,n1,u);
+   }
+}
 #endif  // STB_PERLIN_IMPLEMENTATION
 
 /*
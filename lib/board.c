@@ -0,0 +1,211 @@
+/*
+    board.c: the Minesweeper board engine, see includes/cart_board.h.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../includes/cart_board.h"
+#include "../includes/mssolver.h"
+
+void placeMine(MSBoard *msb, int x, int y) {
+    // make (x,y) a mine and bump the count of each neighbour
+    int s = msb->stride;
+    unsigned char *c = &CELL(msb, x, y);
+    *c |= CELL_MINE;
+    c[-s-1]++; c[-s]++; c[-s+1]++;
+    c[-1]++;            c[1]++;
+    c[s-1]++;  c[s]++;  c[s+1]++;
+}
+
+void removeMine(MSBoard *msb, int x, int y) {
+    // undo placeMine()
+    int s = msb->stride;
+    unsigned char *c = &CELL(msb, x, y);
+    *c &= ~CELL_MINE;
+    c[-s-1]--; c[-s]--; c[-s+1]--;
+    c[-1]--;            c[1]--;
+    c[s-1]--;  c[s]--;  c[s+1]--;
+}
+
+void revealBoard(MSBoard *msb) {
+    // borders are already revealed, so the whole block can be swept
+    int numCells = msb->stride * (msb->height + 2);
+    for (int i = 0; i < numCells; i++) {
+        msb->cells[i] |= CELL_REVEALED;
+    }
+}
+
+MSBoard allocBoard(int width, int height) {
+    MSBoard msb = {
+        .width = width,
+        .height = height,
+        .stride = width + 2,
+        .cells = calloc((size_t)(width + 2) * (height + 2), 1),
+        .mines = 0,
+        .numRevealed = 0
+    };
+
+    for (int x = 0; x < msb.stride; x++) {
+        msb.cells[x] = CELL_BORDER | CELL_REVEALED;
+        msb.cells[(height+1)*msb.stride + x] = CELL_BORDER | CELL_REVEALED;
+    }
+    for (int y = 1; y <= height; y++) {
+        msb.cells[y*msb.stride] = CELL_BORDER | CELL_REVEALED;
+        msb.cells[y*msb.stride + width+1] = CELL_BORDER | CELL_REVEALED;
+    }
+
+    return msb;
+}
+
+void scatterMines(MSBoard *msb) {
+    /* Floyd's form of a partial Fisher-Yates shuffle, which picks a uniformly random set of cells
+       in O(mines) using the board itself as the set of cells picked so far */
+    int numCells = msb->width * msb->height;
+    for (int j = numCells - msb->mines; j < numCells; j++) {
+        int cell = rand() % (j + 1);
+        if (CELL(msb, cell % msb->width, cell / msb->width) & CELL_MINE) cell = j;
+        placeMine(msb, cell % msb->width, cell / msb->width);
+    }
+}
+
+MSBoard createBoard(int width, int height, int mines) {
+    // create board
+    MSBoard msb = allocBoard(width, height);
+    msb.mines = mines;
+
+    // put mines
+    scatterMines(&msb);
+
+    return msb;
+}
+
+void clearFirstMoveArea(MSBoard *msb, int x, int y) {
+    // Lift every mine out of the 3x3 grid centered on (x,y)
+    int moved = 0;
+    for (int i = -1; i <= 1; i++) {
+        for (int j = -1; j <= 1; j++) {
+            if (y + i < 0 || y + i >= msb->height) continue;
+            if (x + j < 0 || x + j >= msb->width) continue;
+            if (CELL(msb, x+j, y+i) & CELL_MINE) {
+                removeMine(msb, x+j, y+i);
+                moved++;
+            }
+        }
+    }
+    if (moved == 0) return;
+
+    /* Put them back with a partial Fisher-Yates shuffle over the free cells outside the grid, so
+       this never fails however dense the board is. If there aren't enough of those, the rest go to
+       free cells inside the grid, which always leaves at least (x,y) itself clear. */
+    int *spots = malloc(sizeof(int) * msb->width * msb->height);
+    int numFree = 0;
+    for (int cy = 0; cy < msb->height; cy++) {
+        for (int cx = 0; cx < msb->width; cx++) {
+            int outsideGrid = (cy < y - 1 || cy > y + 1 || cx < x - 1 || cx > x + 1);
+            if (outsideGrid && !(CELL(msb, cx, cy) & CELL_MINE)) spots[numFree++] = cy * msb->width + cx;
+        }
+    }
+    int numOutside = numFree;
+    if (numOutside < moved) {
+        for (int cy = y - 1; cy <= y + 1; cy++) {
+            for (int cx = x - 1; cx <= x + 1; cx++) {
+                if (cy < 0 || cy >= msb->height || cx < 0 || cx >= msb->width) continue;
+                if (cx == x && cy == y) continue;
+                spots[numFree++] = cy * msb->width + cx;
+            }
+        }
+    }
+
+    for (int i = 0; i < moved; i++) {
+        int end = i < numOutside ? numOutside : numFree;
+        int pick = i + rand() % (end - i);
+        int cell = spots[pick];
+        spots[pick] = spots[i];
+        placeMine(msb, cell % msb->width, cell / msb->width);
+    }
+
+    free(spots);
+}
+
+void placeNoGuessMines(MSBoard *msb, int x, int y, int threads) {
+    // The board was created without its mines; lay them now that the first click is known
+    int numCells = msb->width * msb->height;
+    unsigned char *layout = malloc(numCells);
+    if (layout && ms_generate_noguess(msb->width, msb->height, msb->mines, x, y, rand(), threads,
+                                      layout) == 0) {
+        for (int i = 0; i < numCells; i++) {
+            if (layout[i]) placeMine(msb, i % msb->width, i / msb->width);
+        }
+    } else {
+        // too dense to find one (or out of memory), fall back to an ordinary board with a clear start
+        scatterMines(msb);
+        clearFirstMoveArea(msb, x, y);
+    }
+    free(layout);
+}
+
+int revealMine(MSBoard *msb, int x, int y) {
+    unsigned char *c = &CELL(msb, x, y);
+    *c |= CELL_REVEALED;
+    msb->numRevealed++;
+    if (*c & CELL_MINE) return 1;
+
+    if (*c & CELL_COUNT) return 0; 
+
+    /* Flood-fill reveal all of the connecting non-mine blocks. This is done with a flat queue
+       rather than recursion so huge empty regions can't blow the stack; cells are marked revealed
+       as they are queued, so each one goes in at most once and width*height slots is enough. */
+    int s = msb->stride;
+    int offsets[8] = { -s-1, -s, -s+1, -1, 1, s-1, s, s+1 };
+    int *queue = malloc(sizeof(int) * msb->width * msb->height);
+    int head = 0, tail = 0;
+    queue[tail++] = c - msb->cells;
+
+    while (head < tail) {
+        int cell = queue[head++];
+        for (int i = 0; i < 8; i++) {
+            int n = cell + offsets[i];
+            if (msb->cells[n] & CELL_REVEALED) continue;
+            msb->cells[n] |= CELL_REVEALED;
+            msb->numRevealed++;
+            if (!(msb->cells[n] & (CELL_COUNT | CELL_MINE))) queue[tail++] = n;
+        }
+    }
+
+    free(queue);
+    return 0;
+}
+
+int makeMove(MSBoard *msb, int x, int y, int firstMove, int noGuess, int threads) {
+    // Reveal (x,y), laying or moving mines first if need be so the first move never loses.
+    // Returns 1 if a mine was hit
+    if (firstMove && noGuess) placeNoGuessMines(msb, x, y, threads);
+    if (!revealMine(msb, x, y)) return 0;
+    if (!firstMove) return 1;
+
+    // Take back the reveal, it gets redone once the area is clear
+    CELL(msb, x, y) &= ~CELL_REVEALED;
+    msb->numRevealed--;
+    clearFirstMoveArea(msb, x, y);
+    revealMine(msb, x, y);
+    return 0;
+}
+
+void boardView(MSBoard *msb, signed char *view) {
+    // flags are the player's guesses, so they aren't passed on as known mines
+    for (int y = 0; y < msb->height; y++) {
+        for (int x = 0; x < msb->width; x++) {
+            unsigned char cell = CELL(msb, x, y);
+            int revealed = (cell & CELL_REVEALED) && !(cell & CELL_MINE);
+            view[y*msb->width + x] = revealed ? (cell & CELL_COUNT) : MS_UNKNOWN;
+        }
+    }
+}
+
+void heatmap(MSBoard *msb, float *heat) {
+    signed char *view = malloc(msb->width * msb->height);
+    boardView(msb, view);
+    ms_probabilities(view, msb->width, msb->height, msb->mines, sysconf(_SC_NPROCESSORS_ONLN), heat);
+    free(view);
+}
@@ -0,0 +1,348 @@
+/*
+    ca.c: elementary cellular automata, see includes/cart_ca.h.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../includes/cart_ca.h"
+
+void ecaStep(int rule, const unsigned char *cells, unsigned char *next, int width) {
+    // only the end cells have neighbours to check for; the rest is one lookup each
+    if (width <= 1) {
+        if (width) next[0] = rule >> (cells[0] << 1) & 1;
+        return;
+    }
+    next[0] = rule >> (cells[0] << 1 | cells[1]) & 1;
+    for (int i = 1; i < width - 1; i++) {
+        next[i] = rule >> (cells[i-1] << 2 | cells[i] << 1 | cells[i+1]) & 1;
+    }
+    next[width-1] = rule >> (cells[width-2] << 2 | cells[width-1] << 1) & 1;
+}
+
+int totalisticRule(TotalisticRule *rule, int radius, int states, unsigned long long code) {
+    if (radius < 1 || radius > CA_MAX_RADIUS || states < 2 || states > CA_MAX_STATES) return -1;
+    *rule = (TotalisticRule){ .radius = radius, .states = states };
+    for (int s = 0; s <= (2*radius + 1)*(states - 1); s++) {
+        rule->table[s] = code % states;
+        rule->bits |= (unsigned int)(code % states & 1) << s;
+        code /= states;
+    }
+    return code ? -1 : 0;
+}
+
+/*
+    The totalistic kernels are stamped out from one macro for each radius and number of states,
+    so that each has its neighbourhood sum unrolled and its lookup fixed: a shift of the rule's
+    bits for 2 states, a table for 3. Only the cells within the radius of either end, whose
+    neighbourhoods run off the row, take the general loop.
+*/
+
+#define SUM1(c, i) ((c)[(i)-1] + (c)[i] + (c)[(i)+1])
+#define SUM2(c, i) ((c)[(i)-2] + SUM1(c, i) + (c)[(i)+2])
+#define SUM3(c, i) ((c)[(i)-3] + SUM2(c, i) + (c)[(i)+3])
+#define LOOKUP2(rule, s) ((rule)->bits >> (s) & 1)
+#define LOOKUP3(rule, s) ((rule)->table[s])
+
+static int edgeSum(const unsigned char *cells, int width, int i, int radius) {
+    int sum = 0;
+    for (int j = i - radius; j <= i + radius; j++) {
+        if (j >= 0 && j < width) sum += cells[j];
+    }
+    return sum;
+}
+
+#define TOTALISTIC_KERNEL(R, K) \
+    static void totalistic##R##K(const TotalisticRule *rule, const unsigned char *cells, \
+                                 unsigned char *next, int width) { \
+        int lo = R < width ? R : width, hi = width - R > lo ? width - R : lo; \
+        for (int i = 0; i < lo; i++) next[i] = rule->table[edgeSum(cells, width, i, R)]; \
+        for (int i = lo; i < hi; i++) next[i] = LOOKUP##K(rule, SUM##R(cells, i)); \
+        for (int i = hi; i < width; i++) next[i] = rule->table[edgeSum(cells, width, i, R)]; \
+    }
+
+TOTALISTIC_KERNEL(1, 2)
+TOTALISTIC_KERNEL(1, 3)
+TOTALISTIC_KERNEL(2, 2)
+TOTALISTIC_KERNEL(2, 3)
+TOTALISTIC_KERNEL(3, 2)
+TOTALISTIC_KERNEL(3, 3)
+
+static void (*const totalisticKernels[CA_MAX_RADIUS][CA_MAX_STATES - 1])(const TotalisticRule *,
+        const unsigned char *, unsigned char *, int) = {
+    { totalistic12, totalistic13 },
+    { totalistic22, totalistic23 },
+    { totalistic32, totalistic33 },
+};
+
+void totalisticStep(const TotalisticRule *rule, const unsigned char *cells, unsigned char *next,
+                    int width) {
+    totalisticKernels[rule->radius - 1][rule->states - 2](rule, cells, next, width);
+}
+
+/*
+    EcaLife. A node covers 2^level cells: a leaf (level 3) holds 8 of them as bits, cell i in bit
+    i, and any other node is its two halves. Nodes are hash-consed, so equal segments are the
+    same node and can be compared by pointer.
+
+    step(n, j) is the middle half of n after 2^j generations, for j up to level-2, which is as far
+    as the cells outside the middle half can reach in. For a node [a b c d] in quarters it's put
+    together from the three overlapping halves [a b], [b c], [c d]: their middles after the first
+    part of the run, joined in pairs and stepped again. When j is as big as it can be both parts
+    are recursive steps of 2^(j-1), so one call covers 2^j generations with a handful of lookups.
+*/
+
+#define LEAF_LEVEL 3
+#define MAX_LEVEL 64
+#define BLOCK_BYTES (1 << 16)
+
+typedef struct Node {
+    struct Node *left, *right;      // NULL in a leaf
+    struct Node *next;              // in its hash chain
+    int level;
+    unsigned char bits;             // a leaf's cells
+} Node;
+
+typedef struct Memo {
+    const Node *node;
+    Node *result;
+    int j;
+    struct Memo *next;
+} Memo;
+
+typedef struct Block {
+    struct Block *next;
+    size_t used;
+    char mem[BLOCK_BYTES];
+} Block;
+
+struct EcaLife {
+    int rule;
+    Node leaves[256];
+    Node **nodes;                   // hash table of the other nodes
+    size_t nodeCap, nodeCount;
+    Memo **memos;                   // step's results
+    size_t memoCap, memoCount;
+    Node *uniform[2][MAX_LEVEL];    // all 0s and all 1s, by level
+    Block *blocks;                  // where the nodes and memos live
+
+    Node *root;
+    long long origin;               // where position 0 is in root
+    int background;                 // the cells outside root
+    unsigned long long generation;
+};
+
+static void *arenaAlloc(EcaLife *life, size_t size) {
+    if (!life->blocks || life->blocks->used + size > BLOCK_BYTES) {
+        Block *b = malloc(sizeof(Block));
+        b->next = life->blocks;
+        b->used = 0;
+        life->blocks = b;
+    }
+    void *p = life->blocks->mem + life->blocks->used;
+    life->blocks->used += size;
+    return p;
+}
+
+static size_t hashPair(const void *a, uint64_t b) {
+    uint64_t h = (uint64_t)(uintptr_t)a * 0x9e3779b97f4a7c15ULL ^ b * 0xc2b2ae3d27d4eb4fULL;
+    return h ^ h >> 29;
+}
+
+static Node *join(EcaLife *life, Node *left, Node *right) {
+    size_t h = hashPair(left, (uintptr_t)right) & (life->nodeCap - 1);
+    for (Node *n = life->nodes[h]; n; n = n->next) {
+        if (n->left == left && n->right == right) return n;
+    }
+
+    if (life->nodeCount >= life->nodeCap) {
+        size_t cap = life->nodeCap * 2;
+        Node **nodes = calloc(cap, sizeof(Node *));
+        for (size_t i = 0; i < life->nodeCap; i++) {
+            for (Node *n = life->nodes[i], *next; n; n = next) {
+                next = n->next;
+                size_t k = hashPair(n->left, (uintptr_t)n->right) & (cap - 1);
+                n->next = nodes[k];
+                nodes[k] = n;
+            }
+        }
+        free(life->nodes);
+        life->nodes = nodes;
+        life->nodeCap = cap;
+        h = hashPair(left, (uintptr_t)right) & (cap - 1);
+    }
+
+    Node *n = arenaAlloc(life, sizeof(Node));
+    *n = (Node){ .left = left, .right = right, .next = life->nodes[h], .level = left->level + 1 };
+    life->nodes[h] = n;
+    life->nodeCount++;
+    return n;
+}
+
+static Node *uniform(EcaLife *life, int level, int value) {
+    if (level == LEAF_LEVEL) return &life->leaves[value ? 0xff : 0];
+    if (!life->uniform[value][level]) {
+        Node *half = uniform(life, level - 1, value);
+        life->uniform[value][level] = join(life, half, half);
+    }
+    return life->uniform[value][level];
+}
+
+// The middle half of a node
+static Node *centre(EcaLife *life, const Node *n) {
+    if (n->level == LEAF_LEVEL + 1) return &life->leaves[(n->left->bits >> 4 | n->right->bits << 4) & 0xff];
+    return join(life, n->left->right, n->right->left);
+}
+
+static Node *step(EcaLife *life, Node *n, int j) {
+    size_t h = hashPair(n, j) & (life->memoCap - 1);
+    for (Memo *m = life->memos[h]; m; m = m->next) {
+        if (m->node == n && m->j == j) return m->result;
+    }
+
+    Node *result;
+    if (n->level == LEAF_LEVEL + 1) {
+        // 16 cells, so just run them; each generation the edges are one more cell wrong
+        unsigned int w = n->left->bits | n->right->bits << 8;
+        for (int t = 0; t < 1 << j; t++) {
+            unsigned int next = 0;
+            for (int i = 1; i < 15; i++) {
+                int r = (w >> (i-1) & 1) << 2 | (w >> i & 1) << 1 | (w >> (i+1) & 1);
+                next |= (unsigned int)(life->rule >> r & 1) << i;
+            }
+            w = next;
+        }
+        result = &life->leaves[w >> 4 & 0xff];
+    } else {
+        Node *halves[3] = { n->left, join(life, n->left->right, n->right->left), n->right };
+        Node *r[3];
+        int rest = j;
+        for (int i = 0; i < 3; i++) {
+            if (j == n->level - 2) r[i] = step(life, halves[i], j - 1);
+            else r[i] = centre(life, halves[i]);
+        }
+        if (j == n->level - 2) rest = j - 1;
+        result = join(life, step(life, join(life, r[0], r[1]), rest),
+                      step(life, join(life, r[1], r[2]), rest));
+    }
+
+    if (life->memoCount >= life->memoCap) {
+        size_t cap = life->memoCap * 2;
+        Memo **memos = calloc(cap, sizeof(Memo *));
+        for (size_t i = 0; i < life->memoCap; i++) {
+            for (Memo *m = life->memos[i], *next; m; m = next) {
+                next = m->next;
+                size_t k = hashPair(m->node, m->j) & (cap - 1);
+                m->next = memos[k];
+                memos[k] = m;
+            }
+        }
+        free(life->memos);
+        life->memos = memos;
+        life->memoCap = cap;
+        h = hashPair(n, j) & (cap - 1);
+    }
+    Memo *m = arenaAlloc(life, sizeof(Memo));
+    *m = (Memo){ .node = n, .result = result, .j = j, .next = life->memos[h] };
+    life->memos[h] = m;
+    life->memoCount++;
+    return result;
+}
+
+// Put root in the middle half of a node twice its size
+static void expand(EcaLife *life) {
+    Node *root = life->root;
+    Node *e = uniform(life, root->level - 1, life->background);
+    life->origin += 1LL << (root->level - 1);
+    life->root = join(life, join(life, e, root->left), join(life, root->right, e));
+}
+
+EcaLife *ecaLifeNew(int rule, const unsigned char *cells, int width) {
+    EcaLife *life = calloc(1, sizeof(EcaLife));
+    life->rule = rule;
+    for (int i = 0; i < 256; i++) {
+        life->leaves[i] = (Node){ .level = LEAF_LEVEL, .bits = i };
+    }
+    life->nodeCap = life->memoCap = 1024;
+    life->nodes = calloc(life->nodeCap, sizeof(Node *));
+    life->memos = calloc(life->memoCap, sizeof(Memo *));
+
+    int level = LEAF_LEVEL + 2;
+    while ((1LL << level) < width) level++;
+    int count = 1 << (level - LEAF_LEVEL);
+    Node **row = malloc(sizeof(Node *) * count);
+    for (int i = 0; i < count; i++) {
+        int bits = 0;
+        for (int b = 0; b < 8 && i*8 + b < width; b++) bits |= (cells[i*8 + b] != 0) << b;
+        row[i] = &life->leaves[bits];
+    }
+    for (; count > 1; count /= 2) {
+        for (int i = 0; i < count/2; i++) row[i] = join(life, row[2*i], row[2*i + 1]);
+    }
+    life->root = row[0];
+    free(row);
+    return life;
+}
+
+int ecaLifeAdvance(EcaLife *life, unsigned long long generations) {
+    if (generations > ECA_LIFE_MAX_GENERATIONS - life->generation) return -1;
+
+    // a power of two at a time
+    for (int j = 0; generations >> j; j++) {
+        if (!(generations >> j & 1)) continue;
+        // get everything that isn't background into the middle quarter, with room to grow 2^j
+        for (;;) {
+            Node *root = life->root, *bg = uniform(life, root->level - 2, life->background);
+            if (root->level >= j + 3 && root->left->left == bg && root->right->right == bg) break;
+            expand(life);
+        }
+        expand(life);
+        life->origin -= 1LL << (life->root->level - 2);
+        life->root = step(life, life->root, j);
+
+        // the background is uniform, so it just follows the rule's 000 and 111 entries
+        for (int t = 0; t < (j ? 2 : 1); t++) {
+            life->background = life->rule >> (life->background ? 7 : 0) & 1;
+        }
+    }
+    life->generation += generations;
+    return 0;
+}
+
+void ecaLifeCells(const EcaLife *life, long long from, int count, unsigned char *out) {
+    for (int k = 0; k < count; k++) {
+        long long p = life->origin + from + k;
+        const Node *n = life->root;
+        if (p < 0 || p >= 1LL << n->level) {
+            out[k] = life->background;
+            continue;
+        }
+        while (n->level > LEAF_LEVEL) {
+            long long half = 1LL << (n->level - 1);
+            if (p < half) n = n->left;
+            else {
+                n = n->right;
+                p -= half;
+            }
+        }
+        out[k] = n->bits >> p & 1;
+    }
+}
+
+unsigned long long ecaLifeGeneration(const EcaLife *life) {
+    return life->generation;
+}
+
+size_t ecaLifeNodes(const EcaLife *life) {
+    return life->nodeCount;
+}
+
+void ecaLifeFree(EcaLife *life) {
+    for (Block *b = life->blocks, *next; b; b = next) {
+        next = b->next;
+        free(b);
+    }
+    free(life->nodes);
+    free(life->memos);
+    free(life);
+}
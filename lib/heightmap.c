@@ -0,0 +1,297 @@
+/*
+    heightmap.c: fractal Perlin heightmaps on a work-stealing thread pool, see
+    includes/cart_heightmap.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../includes/stdperlin.h"
+#include "../includes/cart_heightmap.h"
+
+#define DATA_OFFSET sizeof(HeightmapHeader)
+
+typedef struct {
+    pthread_mutex_t lock;
+    int next, end;            // the chunks this thread still has to do
+    int steals;
+    float min, max;
+} Worker;
+
+typedef struct {
+    const HeightmapParams *params;
+    float *heights;
+    int chunksWide, chunks;
+    int numWorkers;
+    Worker *workers;
+    long long *chunkNanos;
+    int *chunkThread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    int done;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int index;
+} WorkerArg;
+
+static long long nanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void renderChunk(Pool *pool, int chunk, Worker *w) {
+    const HeightmapParams *p = pool->params;
+    int x0 = (chunk % pool->chunksWide) * p->chunk, y0 = (chunk / pool->chunksWide) * p->chunk;
+    int x1 = x0 + p->chunk < p->width ? x0 + p->chunk : p->width;
+    int y1 = y0 + p->chunk < p->height ? y0 + p->chunk : p->height;
+
+    for (int y = y0; y < y1; y++) {
+        float ny = (float)y*p->zoom + p->yOffset;
+        float *row = pool->heights + (size_t)y*p->width;
+        for (int x = x0; x < x1; x++) {
+            float nx = (float)x*p->zoom + p->xOffset;
+            float h = p->kind == HEIGHTMAP_RIDGE
+                ? stb_perlin_ridge_noise3(nx, ny, p->z, p->lacunarity, p->gain, p->offset, p->octaves)
+                : stb_perlin_fbm_noise3(nx, ny, p->z, p->lacunarity, p->gain, p->octaves);
+            row[x] = h;
+            if (h < w->min) w->min = h;
+            if (h > w->max) w->max = h;
+        }
+    }
+}
+
+// Take the back half of the biggest run left, or return 0 if there's nothing left anywhere
+static int steal(Pool *pool, int self) {
+    Worker *me = &pool->workers[self];
+    for (;;) {
+        int victim = -1, most = 0;
+        for (int i = 0; i < pool->numWorkers; i++) {
+            // a racy look, rechecked under the victim's lock below
+            Worker *w = &pool->workers[i];
+            pthread_mutex_lock(&w->lock);
+            int left = w->end - w->next;
+            pthread_mutex_unlock(&w->lock);
+            if (i != self && left > most) {
+                most = left;
+                victim = i;
+            }
+        }
+        if (victim < 0) return 0;
+
+        Worker *v = &pool->workers[victim];
+        pthread_mutex_lock(&v->lock);
+        int left = v->end - v->next;
+        if (left <= 0) {
+            pthread_mutex_unlock(&v->lock);
+            continue;
+        }
+        int take = (left + 1) / 2;
+        int from = v->end - take, to = v->end;
+        v->end = from;
+        pthread_mutex_unlock(&v->lock);
+
+        pthread_mutex_lock(&me->lock);
+        me->next = from;
+        me->end = to;
+        me->steals++;
+        pthread_mutex_unlock(&me->lock);
+        return 1;
+    }
+}
+
+static void *workerMain(void *arg) {
+    Pool *pool = ((WorkerArg *)arg)->pool;
+    int self = ((WorkerArg *)arg)->index;
+    Worker *me = &pool->workers[self];
+
+    for (;;) {
+        pthread_mutex_lock(&me->lock);
+        int chunk = me->next < me->end ? me->next++ : -1;
+        pthread_mutex_unlock(&me->lock);
+        if (chunk < 0) {
+            if (!steal(pool, self)) break;
+            continue;
+        }
+
+        long long start = nanos();
+        renderChunk(pool, chunk, me);
+        pool->chunkNanos[chunk] = nanos() - start;
+        pool->chunkThread[chunk] = self;
+
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->done == pool->chunks) pthread_cond_signal(&pool->finished);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+int writeHeightmap(const HeightmapParams *p, const char *path, HeightmapStats *stats,
+                   void (*progress)(int done, int total, void *ctx), void *ctx) {
+    size_t bytes = DATA_OFFSET + sizeof(float) * (size_t)p->width * p->height;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, bytes)) {
+        close(fd);
+        return -1;
+    }
+    char *map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    Pool pool = {
+        .params = p,
+        .heights = (float *)(map + DATA_OFFSET),
+        .chunksWide = (p->width + p->chunk - 1) / p->chunk,
+    };
+    pool.chunks = pool.chunksWide * ((p->height + p->chunk - 1) / p->chunk);
+    pool.numWorkers = p->threads < 1 ? 1 : p->threads > pool.chunks ? pool.chunks : p->threads;
+    pool.workers = calloc(pool.numWorkers, sizeof(Worker));
+    pool.chunkNanos = calloc(pool.chunks, sizeof(long long));
+    pool.chunkThread = calloc(pool.chunks, sizeof(int));
+    pthread_t *tids = malloc(sizeof(pthread_t) * pool.numWorkers);
+    WorkerArg *args = malloc(sizeof(WorkerArg) * pool.numWorkers);
+    char *started = calloc(pool.numWorkers, 1);
+    if (!pool.workers || !pool.chunkNanos || !pool.chunkThread || !tids || !args || !started) {
+        free(pool.workers);
+        free(pool.chunkNanos);
+        free(pool.chunkThread);
+        free(tids);
+        free(args);
+        free(started);
+        munmap(map, bytes);
+        errno = ENOMEM;
+        return -1;
+    }
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.finished, NULL);
+
+    // every thread starts on its own band of the image
+    for (int i = 0; i < pool.numWorkers; i++) {
+        Worker *w = &pool.workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->next = (long long)pool.chunks * i / pool.numWorkers;
+        w->end = (long long)pool.chunks * (i + 1) / pool.numWorkers;
+        w->min = 1e30f;
+        w->max = -1e30f;
+    }
+
+    long long start = nanos();
+    for (int i = 0; i < pool.numWorkers; i++) {
+        args[i] = (WorkerArg){ &pool, i };
+        started[i] = !pthread_create(&tids[i], NULL, workerMain, &args[i]);
+    }
+    // workers whose thread couldn't be made are run here, or their chunks would never be done
+    for (int i = 0; i < pool.numWorkers; i++) {
+        if (!started[i]) workerMain(&args[i]);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.done < pool.chunks) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += 250000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pool.finished, &pool.lock, &until);
+        int done = pool.done;
+        if (progress && done < pool.chunks) {
+            pthread_mutex_unlock(&pool.lock);
+            progress(done, pool.chunks, ctx);
+            pthread_mutex_lock(&pool.lock);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < pool.numWorkers; i++) {
+        if (started[i]) pthread_join(tids[i], NULL);
+    }
+    double seconds = (nanos() - start) / 1e9;
+    if (progress) progress(pool.chunks, pool.chunks, ctx);
+
+    HeightmapHeader h = {
+        .version = HEIGHTMAP_VERSION,
+        .dataOffset = DATA_OFFSET,
+        .width = p->width, .height = p->height,
+        .kind = p->kind,
+        .octaves = p->octaves,
+        .lacunarity = p->lacunarity, .gain = p->gain, .offset = p->offset,
+        .zoom = p->zoom, .xOffset = p->xOffset, .yOffset = p->yOffset, .z = p->z,
+        .min = 1e30f, .max = -1e30f,
+    };
+    memcpy(h.magic, HEIGHTMAP_MAGIC, sizeof h.magic);
+    int steals = 0;
+    for (int i = 0; i < pool.numWorkers; i++) {
+        Worker *w = &pool.workers[i];
+        if (w->min < h.min) h.min = w->min;
+        if (w->max > h.max) h.max = w->max;
+        steals += w->steals;
+        pthread_mutex_destroy(&w->lock);
+    }
+    memcpy(map, &h, sizeof h);
+    munmap(map, bytes);
+
+    if (stats) {
+        *stats = (HeightmapStats){
+            .chunks = pool.chunks, .threads = pool.numWorkers, .steals = steals, .seconds = seconds,
+            .chunkNanos = pool.chunkNanos, .chunkThread = pool.chunkThread,
+            .min = h.min, .max = h.max,
+        };
+    } else {
+        free(pool.chunkNanos);
+        free(pool.chunkThread);
+    }
+    pthread_cond_destroy(&pool.finished);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.workers);
+    free(tids);
+    free(args);
+    free(started);
+    return 0;
+}
+
+void freeHeightmapStats(HeightmapStats *stats) {
+    free(stats->chunkNanos);
+    free(stats->chunkThread);
+    stats->chunkNanos = NULL;
+    stats->chunkThread = NULL;
+}
+
+const HeightmapHeader *mapHeightmap(const char *path, size_t *bytes) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(HeightmapHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const HeightmapHeader *h = map;
+    if (memcmp(h->magic, HEIGHTMAP_MAGIC, sizeof h->magic) || h->version != HEIGHTMAP_VERSION
+        || (size_t)st.st_size < h->dataOffset + sizeof(float) * (size_t)h->width * h->height) {
+        munmap(map, st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+    *bytes = st.st_size;
+    return h;
+}
+
+void unmapHeightmap(const HeightmapHeader *header, size_t bytes) {
+    munmap((void *)header, bytes);
+}
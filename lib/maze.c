@@ -0,0 +1,106 @@
+/*
+    maze.c: maze generation and drawing, see includes/cart_maze.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../includes/cart_maze.h"
+
+Maze createMaze(int rows, int cols) {
+    Maze m = { .rows = rows, .cols = cols };
+    m.tiles = malloc(sizeof(struct Tile *) * rows);
+    m.visited = malloc(sizeof(short *) * rows);
+    for (int i = 0; i < rows; i++) {
+        m.tiles[i] = malloc(sizeof(struct Tile)*cols);
+        m.visited[i] = malloc(sizeof(short)*cols);
+    }
+
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            m.tiles[r][c].down = 1;
+            m.tiles[r][c].right = 1;
+            m.visited[r][c] = 0;
+        }
+    }
+
+    m.numtiles = rows*cols;
+    m.numvisited = 0; /* So bt() knows when it can just exit the do while loop if all tiles visited without needing to 
+                         iterate through it again every step back. Makes the animation end immediately when this happens
+                         rather than continuing visually frozen for as many frames as it needs to backtrack to the start. */
+    return m;
+}
+
+void freeMaze(Maze *m) {
+    for (int i = 0; i < m->rows; i++) {
+        free(m->tiles[i]);
+        free(m->visited[i]);
+    }
+    free(m->tiles);
+    free(m->visited);
+}
+
+void drawmaze(const Maze *m) {
+    const char* crosses[16] = {" ", "╺", "╸", "━", "╻", "┏", "┓", "┳", "╹", "┗", "┛", "┻", "┃", "┣", "┫", "╋"};
+    int rows = m->rows, cols = m->cols;
+    struct Tile **maze = m->tiles;
+    for (int r = -1; r < rows; r++) {
+        for (int c = -1; c < cols; c++) {
+            int arms = 0; // 0000 : up, down, left, right
+            if ((r != -1 && c != -1 && maze[r][c].right == 1) || (c == -1 && r != -1)) arms += 0b1000;
+            if ((c != -1 && r != -1 && maze[r][c].down == 1) || (r == -1 && c != -1)) arms += 0b0010;
+            if ((c != cols-1 && r != -1 && maze[r][c+1].down == 1) || (r == -1 && c != cols-1)) arms += 0b0001;
+            if ((r != rows-1 && c != -1 && maze[r+1][c].right == 1) || (c == -1 && r != rows-1)) arms += 0b0100;
+            if ((c != -1 && r != -1 && maze[r][c].down == 1) || (r == -1 && c != -1)) {
+                printf("━");
+            } else if (c != -1) {
+                printf(" ");
+            }
+            printf("%s", crosses[arms]);
+        }
+        printf("\n");
+    }
+}
+
+void bt(Maze *m, int row, int col, int depth) {
+    int v_c;
+    int rows = m->rows, cols = m->cols;
+    struct Tile **maze = m->tiles;
+    short **visited = m->visited;
+    visited[row][col] = 1;
+    m->numvisited++;
+    do {
+        // pick random direction to tunnel toward
+        int dir[4];
+        v_c = 0; // valid_choices
+        if (row != 0 && visited[row-1][col] == 0) dir[v_c++] = 0; // up 0 is avaliable
+        if (col != 0 && visited[row][col-1] == 0) dir[v_c++] = 2; // left 2 is availabe
+        if (row != rows-1 && visited[row+1][col] == 0) dir[v_c++] = 1; // down 1 is available
+        if (col != cols-1 && visited[row][col+1] == 0) dir[v_c++] = 3; // right 3 is available
+        if (v_c == 0) 
+            return; // nowhere to tunnel from here. move back
+
+        if (m->onStep) m->onStep(m, row, col, depth);
+        
+        int pick = rand() % v_c;
+        
+        switch (dir[pick]) {
+            case 0: // up
+                maze[row-1][col].down = 0;
+                bt(m, row-1, col, depth+1);
+                break;
+            case 1: // down
+                maze[row][col].down = 0;
+                bt(m, row+1, col, depth+1);
+                break;
+            case 2: // left
+                maze[row][col-1].right = 0;
+                bt(m, row, col-1, depth+1);
+                break;
+            case 3: // right
+                maze[row][col].right = 0;
+                bt(m, row, col+1, depth+1);
+                break;
+        }
+    } while (v_c > 1 && m->numvisited <= m->numtiles);
+}
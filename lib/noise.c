@@ -0,0 +1,309 @@
+/*
+    noise.c: grain's Perlin noise renderer, see includes/cart_noise.h.
+
+    Uses https://github.com/nothings/stb/blob/master/stb_perlin.h for Perlin noise.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+
+#define STB_PERLIN_IMPLEMENTATION
+#include "../includes/stdperlin.h"
+#include "../includes/cart_noise.h"
+
+/* Bound on |dn/dx| (and, the same way, |dn/dy|) for stb_perlin_noise2. Along x the noise is
+   lerp(n0, n1, u) with u the eased fraction, so dn/dx is a lerp of the corners' x gradients (at
+   most 1) plus u'(x)*(n1 - n0). u' peaks at 30/16 = 1.875 and |n1 - n0| is at most 2, so
+   |dn/dx| <= 1 + 1.875*2. The noise is continuous over cell edges and wraps, so this holds
+   between any two points: |n(p) - n(q)| <= 4.75*(|dx| + |dy|). */
+#define GRAIN_LIPSCHITZ 4.75
+// Slack for float rounding in the noise and in the block centre, far above either
+#define GRAIN_MARGIN 1e-4
+/* The noise rarely gets further from 0 than this, so blocks that would need it to aren't worth
+   sampling the middle of, and are split straight away */
+#define GRAIN_TRY_BELOW 0.7
+// Blocks of this many cells or fewer are just sampled
+#define GRAIN_LEAF 1
+// Character rows classified at a time by renderGrain, which bounds its memory
+#define GRAIN_STRIP 64
+// Pixel rows per strip of an image (even, so strips start on a character row)
+#define GRAIN_IMAGE_STRIP 64
+// Strips an image may have rendered but not yet written, per thread
+#define GRAIN_IMAGE_SLOTS 2
+
+char *grainSymbols[16] = {" ","▖","▘","▌","▗","▄","▚","▙","▝","▞","▀","▛","▐","▟","▜","█"};
+
+/* A grid of samples: sample (i,j) is at ((i + i0)*zoom + xOffset, (j + j0)*zoom + yOffset), worked
+   out in float exactly that way. Sample column i is the left half of character column i/2 when i
+   is even and the right half when it's odd, and sample row j the top or bottom half of character
+   row j/2 the same way. */
+typedef struct {
+    int i0, j0;
+    float zoom, xOffset, yOffset;
+    int seed;
+} Lattice;
+
+static float sampleX(const Lattice *l, int i) {
+    return (float)(i + l->i0)*l->zoom + l->xOffset;
+}
+
+static float sampleY(const Lattice *l, int j) {
+    return (float)(j + l->j0)*l->zoom + l->yOffset;
+}
+
+// The lattice of a view's samples, moved along to start at character cell (x0,y0)
+static Lattice viewLattice(const GrainView *v, int x0, int y0) {
+    Lattice l = {
+        .i0 = 2*x0 - v->width/2*2, .j0 = 2*y0 - v->height/2*2,
+        .zoom = v->zoom, .xOffset = v->xOffset, .yOffset = v->yOffset,
+        .seed = v->seed
+    };
+    return l;
+}
+
+/* Which quadrants of cell (x,y) have positive noise in the low 4 bits, in grainSymbols order, and
+   which have negative noise in the high 4 */
+static int cellSigns(const Lattice *l, int x, int y) {
+    float left   = sampleX(l, 2*x);
+    float right  = sampleX(l, 2*x + 1);
+    float top    = sampleY(l, 2*y);
+    float bottom = sampleY(l, 2*y + 1);
+    float n[4] = {
+        stb_perlin_noise2_seed(left, bottom, 0, 0, l->seed),  // Bottom left
+        stb_perlin_noise2_seed(left, top, 0, 0, l->seed),     // Top left
+        stb_perlin_noise2_seed(right, bottom, 0, 0, l->seed), // Bottom right
+        stb_perlin_noise2_seed(right, top, 0, 0, l->seed),    // Top right
+    };
+
+    int signs = 0;
+    for (int q = 0; q < 4; q++) {
+        if (n[q] > 0) signs |= 1 << q;
+        else if (n[q] < 0) signs |= 0x10 << q;
+    }
+    return signs;
+}
+
+// The grainSymbols index for a view from a cell's signs
+static int pickSigns(const GrainView *v, int signs) {
+    return v->invert > 0 ? signs & 0xf : v->invert < 0 ? signs >> 4 : 0;
+}
+
+int grainCell(const GrainView *v, int x, int y) {
+    Lattice l = viewLattice(v, 0, 0);
+    return pickSigns(v, cellSigns(&l, x, y));
+}
+
+/* Fill in the cellSigns of columns [x0,x1) and rows [y0,y1) of out, which has 'stride' cells a
+   row. The middle of the block is sampled, and if the noise there is further from 0 than it can
+   change by anywhere in the block, every sample has its sign. Otherwise the block is split in
+   four, down to single cells. Samples' coordinates only grow with their index, so the block's
+   corner samples bound the rest. */
+static void classify(const Lattice *l, unsigned char *out, int stride, int x0, int x1, int y0, int y1) {
+    if ((x1 - x0) * (y1 - y0) <= GRAIN_LEAF) {
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) out[y*stride + x] = cellSigns(l, x, y);
+        }
+        return;
+    }
+
+    float left = sampleX(l, 2*x0), right = sampleX(l, 2*x1 - 1);
+    float top = sampleY(l, 2*y0), bottom = sampleY(l, 2*y1 - 1);
+    float cx = left + (right - left)*0.5f, cy = top + (bottom - top)*0.5f;
+    double reach = fmax(fabs((double)cx - left), fabs((double)right - cx))
+                 + fmax(fabs((double)cy - top), fabs((double)bottom - cy));
+    double needed = GRAIN_LIPSCHITZ*reach + GRAIN_MARGIN;
+
+    if (needed < GRAIN_TRY_BELOW) {
+        float n = stb_perlin_noise2_seed(cx, cy, 0, 0, l->seed);
+        if (fabs(n) > needed) {
+            unsigned char all = n > 0 ? 0x0f : 0xf0;
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) out[y*stride + x] = all;
+            }
+            return;
+        }
+    }
+
+    int xm = x0 + (x1 - x0)/2, ym = y0 + (y1 - y0)/2;
+    if (xm > x0 && ym > y0) {
+        classify(l, out, stride, x0, xm, y0, ym);
+        classify(l, out, stride, xm, x1, y0, ym);
+        classify(l, out, stride, x0, xm, ym, y1);
+        classify(l, out, stride, xm, x1, ym, y1);
+    } else if (xm > x0) {
+        classify(l, out, stride, x0, xm, y0, y1);
+        classify(l, out, stride, xm, x1, y0, y1);
+    } else {
+        classify(l, out, stride, x0, x1, y0, ym);
+        classify(l, out, stride, x0, x1, ym, y1);
+    }
+}
+
+/* The cellSigns of a cols x rows block of cells of a lattice, adaptively unless 'exhaustive'.
+   When the samples are so far apart that a 3x3 block of cells (6x6 samples, 5 apart corner to
+   corner on each axis) couldn't be settled at once, the blocks that can are too few to pay for
+   the ones that can't, so those are sampled in full too. */
+static void latticeSigns(const Lattice *l, int cols, int rows, int exhaustive, unsigned char *out) {
+    if (exhaustive || GRAIN_LIPSCHITZ*5*fabs(l->zoom) + GRAIN_MARGIN >= GRAIN_TRY_BELOW) {
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < cols; x++) out[y*cols + x] = cellSigns(l, x, y);
+        }
+        return;
+    }
+    classify(l, out, cols, 0, cols, 0, rows);
+}
+
+void grainRows(const GrainView *v, int y0, int rows, unsigned char *idx) {
+    Lattice l = viewLattice(v, 0, y0);
+    latticeSigns(&l, v->width, rows, v->exhaustive, idx);
+    for (int k = 0; k < rows*v->width; k++) idx[k] = pickSigns(v, idx[k]);
+}
+
+void grainTile(int seed, float zoom, int tx, int ty, unsigned char *signs) {
+    Lattice l = {
+        .i0 = tx*2*GRAIN_TILE, .j0 = ty*2*GRAIN_TILE,
+        .zoom = zoom,
+        .seed = seed
+    };
+    latticeSigns(&l, GRAIN_TILE, GRAIN_TILE, 0, signs);
+}
+
+void renderGrain(const GrainView *v, FILE *out) {
+    int strip = v->height < GRAIN_STRIP ? v->height : GRAIN_STRIP;
+    unsigned char *idx = malloc((size_t)strip * v->width);
+    for (int y0 = 0; y0 < v->height; y0 += strip) {
+        int rows = v->height - y0 < strip ? v->height - y0 : strip;
+        grainRows(v, y0, rows, idx);
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < v->width; x++) {
+                fputs(grainSymbols[idx[y*v->width + x]], out);
+            }
+            fputc('\n', out);
+        }
+    }
+    free(idx);
+}
+
+typedef struct {
+    const GrainView *view;
+    GrainFormat format;
+    int pixelsWide, pixelsHigh, rowBytes;
+    int strips, slots;
+    unsigned char **buf;    // slot i holds strip s while s % slots == i
+    int *ready;             // whether the slot's strip is rendered
+    int next, written;      // next strip to hand out, next strip to write
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} ImageJob;
+
+static void renderStrip(ImageJob *job, int strip, unsigned char *pixels, unsigned char *idx) {
+    const GrainView *v = job->view;
+    Lattice l = viewLattice(v, 0, 0);
+    int j0 = strip*GRAIN_IMAGE_STRIP;
+    int rows = job->pixelsHigh - j0 < GRAIN_IMAGE_STRIP ? job->pixelsHigh - j0 : GRAIN_IMAGE_STRIP;
+
+    if (job->format == GRAIN_PGM) {
+        for (int r = 0; r < rows; r++) {
+            float y = sampleY(&l, j0 + r);
+            unsigned char *row = pixels + (size_t)r*job->rowBytes;
+            for (int i = 0; i < job->pixelsWide; i++) {
+                float n = v->invert*stb_perlin_noise2_seed(sampleX(&l, i), y, 0, 0, v->seed);
+                int grey = (int)((n + 1)*127.5f + 0.5f);
+                row[i] = grey < 0 ? 0 : grey > 255 ? 255 : grey;
+            }
+        }
+        return;
+    }
+
+    // a PBM's pixels are the grain cells' quadrants, so the adaptive classifier does the work
+    grainRows(v, j0/2, rows/2, idx);
+    for (int r = 0; r < rows; r++) {
+        const unsigned char *cells = idx + (size_t)(r/2)*v->width;
+        int left = r & 1 ? 0b0001 : 0b0010, right = r & 1 ? 0b0100 : 0b1000;
+        unsigned char *row = pixels + (size_t)r*job->rowBytes;
+        for (int b = 0; b < job->rowBytes; b++) row[b] = 0;
+        for (int i = 0; i < job->pixelsWide; i++) {
+            if (cells[i/2] & (i & 1 ? right : left)) row[i/8] |= 0x80 >> (i & 7);
+        }
+    }
+}
+
+static void *imageWorker(void *arg) {
+    ImageJob *job = arg;
+    unsigned char *idx = malloc((size_t)job->view->width*(GRAIN_IMAGE_STRIP/2));
+    pthread_mutex_lock(&job->lock);
+    for (;;) {
+        // a strip can only go in its slot once the strip that was there has been written
+        while (job->next < job->strips && job->next >= job->written + job->slots) {
+            pthread_cond_wait(&job->changed, &job->lock);
+        }
+        if (job->next >= job->strips) break;
+        int strip = job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        renderStrip(job, strip, job->buf[strip % job->slots], idx);
+
+        pthread_mutex_lock(&job->lock);
+        job->ready[strip % job->slots] = 1;
+        pthread_cond_broadcast(&job->changed);
+    }
+    pthread_mutex_unlock(&job->lock);
+    free(idx);
+    return NULL;
+}
+
+int writeGrainImage(const GrainView *v, FILE *out, GrainFormat format, int threads) {
+    ImageJob job = {
+        .view = v,
+        .format = format,
+        .pixelsWide = 2*v->width,
+        .pixelsHigh = 2*v->height,
+    };
+    job.rowBytes = format == GRAIN_PGM ? job.pixelsWide : (job.pixelsWide + 7)/8;
+    job.strips = (job.pixelsHigh + GRAIN_IMAGE_STRIP - 1)/GRAIN_IMAGE_STRIP;
+    if (threads < 1) threads = 1;
+    if (threads > job.strips) threads = job.strips;
+    job.slots = threads*GRAIN_IMAGE_SLOTS;
+    job.buf = malloc(sizeof(unsigned char *)*job.slots);
+    job.ready = calloc(job.slots, sizeof(int));
+    for (int i = 0; i < job.slots; i++) job.buf[i] = malloc((size_t)job.rowBytes*GRAIN_IMAGE_STRIP);
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+
+    int failed = fprintf(out, "%s\n%d %d\n%s", format == GRAIN_PGM ? "P5" : "P4", job.pixelsWide,
+                         job.pixelsHigh, format == GRAIN_PGM ? "255\n" : "") < 0;
+
+    pthread_t *workers = malloc(sizeof(pthread_t)*threads);
+    for (int t = 0; t < threads; t++) pthread_create(&workers[t], NULL, imageWorker, &job);
+
+    // write the strips in order as they come in, freeing their slots for the workers
+    for (int strip = 0; strip < job.strips; strip++) {
+        int slot = strip % job.slots;
+        pthread_mutex_lock(&job.lock);
+        while (!job.ready[slot]) pthread_cond_wait(&job.changed, &job.lock);
+        pthread_mutex_unlock(&job.lock);
+
+        int rows = job.pixelsHigh - strip*GRAIN_IMAGE_STRIP;
+        if (rows > GRAIN_IMAGE_STRIP) rows = GRAIN_IMAGE_STRIP;
+        size_t bytes = (size_t)job.rowBytes*rows;
+        if (!failed && fwrite(job.buf[slot], 1, bytes, out) != bytes) failed = 1;
+
+        pthread_mutex_lock(&job.lock);
+        job.ready[slot] = 0;
+        job.written++;
+        pthread_cond_broadcast(&job.changed);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    for (int t = 0; t < threads; t++) pthread_join(workers[t], NULL);
+    if (fflush(out)) failed = 1;
+    pthread_cond_destroy(&job.changed);
+    pthread_mutex_destroy(&job.lock);
+    for (int i = 0; i < job.slots; i++) free(job.buf[i]);
+    free(job.buf);
+    free(job.ready);
+    free(workers);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,130 @@
+/*
+    screen.c: the diffing terminal renderer, see includes/cart_screen.h.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../includes/cart_screen.h"
+
+/* Colours cells are drawn in: the numbers 0-8, then the rest. Each starts from a reset so that
+   switching from any one to another takes a single escape. */
+static const char *colors[] = {
+    "\033[0;90m",
+    "\033[0;94m",
+    "\033[0;32m",
+    "\033[0;91m",
+    "\033[0;34m",
+    "\033[0;31m",
+    "\033[0;36m",
+    "\033[0m", // normally black
+    "\033[0;95m",
+    "\033[0m",
+    "\033[0;31m",
+    "\033[0;32m",
+    "\033[0;33m"
+};
+#define COLOR_PLAIN  9
+#define COLOR_RED    10
+#define COLOR_GREEN  11
+#define COLOR_YELLOW 12
+
+static void emit(Screen *scr, const char *fmt, ...) {
+    va_list ap;
+    while (1) {
+        va_start(ap, fmt);
+        size_t room = scr->cap - scr->len;
+        int n = vsnprintf(scr->buf + scr->len, room, fmt, ap);
+        va_end(ap);
+        if ((size_t)n < room) {
+            scr->len += n;
+            return;
+        }
+        scr->cap = scr->cap * 2 + n;
+        scr->buf = realloc(scr->buf, scr->cap);
+    }
+}
+
+static unsigned short boardGlyph(unsigned char cell) {
+    if (cell & CELL_FLAGGED) return COLOR_RED << 8 | 'F';
+    if (!(cell & CELL_REVEALED)) return COLOR_PLAIN << 8 | '*';
+    if (cell & CELL_MINE) return COLOR_PLAIN << 8 | 'M';
+    return (cell & CELL_COUNT) << 8 | ('0' + (cell & CELL_COUNT));
+}
+
+static unsigned short heatGlyph(float p) {
+    if (p < 0) return COLOR_PLAIN << 8 | ' ';
+    if (p == 0) return COLOR_GREEN << 8 | '-';
+    if (p == 1) return COLOR_RED << 8 | '!';
+    int color = p < 0.2 ? COLOR_GREEN : p < 0.5 ? COLOR_YELLOW : COLOR_RED;
+    return color << 8 | ('0' + (p >= 0.9 ? 9 : (int)(p * 10)));
+}
+
+void drawBoard(Screen *scr, const MSBoard *msb, const float *heat) {
+    // heat, if given, is drawn as a second grid to the right (see heatmap())
+    int width = msb->width * (heat ? 2 : 1);
+    scr->len = 0;
+
+    if (scr->width != width || scr->height != msb->height) {
+        // first frame (or a new layout): clear, draw the frame around the cells, redraw every cell
+        scr->width = width;
+        scr->height = msb->height;
+        free(scr->cells);
+        scr->cells = malloc(sizeof(unsigned short) * width * msb->height);
+        memset(scr->cells, 0xFF, sizeof(unsigned short) * width * msb->height);
+
+        emit(scr, "\033[0m\033[H\033[2J");
+        for (int pass = 0; pass < (heat ? 2 : 1); pass++) {
+            emit(scr, pass ? " " : "   | ");
+            for (int i = 0; i < msb->width; i++) {
+                emit(scr, "%c ", i >= 26 ? 'A' + i-26 : 'a' + i);
+            }
+        }
+        emit(scr, "\n---+");
+        for (int i = 0; i < width; i++) {
+            emit(scr, "--");
+        }
+        for (int y = 0; y < msb->height; y++) {
+            emit(scr, "\n%2i | ", y+1);
+        }
+    }
+
+    // the cursor position and colour the terminal is known to be in, -1 when unknown
+    int curRow = -1, curCol = -1, curColor = -1;
+    for (int y = 0; y < msb->height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned short glyph = x < msb->width ? boardGlyph(CELL(msb, x, y))
+                                                 : heatGlyph(heat[y*msb->width + x - msb->width]);
+            unsigned short *prev = &scr->cells[y*width + x];
+            if (*prev == glyph) continue;
+            *prev = glyph;
+
+            int row = y + 3, col = 6 + 2*x + (x >= msb->width); // 1-based, past the row labels
+            if (row != curRow || col != curCol) emit(scr, "\033[%d;%dH", row, col);
+            if (glyph >> 8 != curColor) emit(scr, "%s", colors[glyph >> 8]);
+            emit(scr, "%c ", glyph & 0xFF);
+            curRow = row;
+            curCol = col + 2;
+            curColor = glyph >> 8;
+        }
+    }
+
+    // leave the cursor under the board, clearing whatever was printed there last turn
+    emit(scr, "\033[0m\033[%d;1H\033[J", msb->height + 3);
+
+    fflush(stdout);
+    for (size_t off = 0; off < scr->len; ) {
+        ssize_t n = write(STDOUT_FILENO, scr->buf + off, scr->len - off);
+        if (n <= 0) break;
+        off += n;
+    }
+}
+
+void freeScreen(Screen *scr) {
+    free(scr->cells);
+    free(scr->buf);
+    *scr = (Screen){ 0 };
+}
@@ -0,0 +1,6 @@
+/*
+    solver.c: the implementation of includes/mssolver.h, compiled once for everything in libcart.
+*/
+
+#define MS_SOLVER_IMPLEMENTATION
+#include "../includes/mssolver.h"
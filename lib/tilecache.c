@@ -0,0 +1,221 @@
+/*
+    tilecache.c: the on-disk cache of grain's noise tiles, see includes/cart_tilecache.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "../includes/cart_tilecache.h"
+
+#define TILE_MAGIC "CARTTILE"
+#define TILE_VERSION 1      // bump whenever grainTile's output changes
+
+typedef struct {
+    char magic[8];          // TILE_MAGIC, not terminated
+    uint32_t version;
+    uint32_t width, height; // GRAIN_TILE, the signs follow row by row
+    uint32_t reserved;
+} TileHeader;               // 24 bytes
+
+#define TILE_BYTES (GRAIN_TILE*GRAIN_TILE)
+#define FILE_BYTES (sizeof(TileHeader) + TILE_BYTES)
+
+typedef struct {
+    const unsigned char *signs;
+    int mapped;             // signs is an mmap of the tile's file rather than malloc'd
+} TileRef;
+
+typedef struct {
+    char name[64];
+    long long size;
+    struct timespec used;
+} TileFile;
+
+static int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// mkdir -p
+static int makeDirs(const char *dir) {
+    if (!*dir) {
+        errno = ENOENT;
+        return -1;
+    }
+    char *path = strdup(dir);
+    for (char *p = path + 1; ; p++) {
+        if (*p == '/' || *p == '\0') {
+            char c = *p;
+            *p = '\0';
+            if (mkdir(path, 0755) && errno != EEXIST) {
+                free(path);
+                return -1;
+            }
+            if (!(*p = c)) break;
+        }
+    }
+    free(path);
+    return 0;
+}
+
+static void tileName(char *name, size_t size, int seed, float zoom, int tx, int ty) {
+    unsigned int zoomBits;
+    memcpy(&zoomBits, &zoom, sizeof zoomBits);
+    snprintf(name, size, "%08x_%08x_%d_%d.tile", (unsigned int)seed, zoomBits, tx, ty);
+}
+
+/* The tile from the cache if it's there, marking it as just used, otherwise computed and written
+   to the cache */
+static TileRef getTile(const char *dir, int seed, float zoom, int tx, int ty, TileCacheStats *stats) {
+    TileRef ref = { 0 };
+    char name[64];
+    tileName(name, sizeof name, seed, zoom, tx, ty);
+    char *path = malloc(strlen(dir) + sizeof name + 2);
+    sprintf(path, "%s/%s", dir, name);
+
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (!fstat(fd, &st) && st.st_size == FILE_BYTES) {
+            char *map = mmap(NULL, FILE_BYTES, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                const TileHeader *h = (const TileHeader *)map;
+                if (!memcmp(h->magic, TILE_MAGIC, sizeof h->magic) && h->version == TILE_VERSION
+                    && h->width == GRAIN_TILE && h->height == GRAIN_TILE) {
+                    futimens(fd, NULL);
+                    close(fd);
+                    free(path);
+                    ref.signs = (const unsigned char *)map + sizeof(TileHeader);
+                    ref.mapped = 1;
+                    stats->hits++;
+                    return ref;
+                }
+                munmap(map, FILE_BYTES);
+            }
+        }
+        // anything else is from another version of grain or broken, and is written over below
+        close(fd);
+    }
+
+    unsigned char *signs = malloc(TILE_BYTES);
+    grainTile(seed, zoom, tx, ty, signs);
+    stats->misses++;
+
+    char *tmp = malloc(strlen(dir) + 16);
+    sprintf(tmp, "%s/tmp.XXXXXX", dir);
+    fd = mkstemp(tmp);
+    if (fd >= 0) {
+        TileHeader h = { .version = TILE_VERSION, .width = GRAIN_TILE, .height = GRAIN_TILE };
+        memcpy(h.magic, TILE_MAGIC, sizeof h.magic);
+        int ok = write(fd, &h, sizeof h) == sizeof h && write(fd, signs, TILE_BYTES) == TILE_BYTES;
+        if (close(fd)) ok = 0;
+        if (!ok || rename(tmp, path)) unlink(tmp);
+    }
+    free(tmp);
+    free(path);
+    ref.signs = signs;
+    return ref;
+}
+
+static void dropTile(TileRef *ref) {
+    if (ref->mapped) munmap((void *)(ref->signs - sizeof(TileHeader)), FILE_BYTES);
+    else free((void *)ref->signs);
+    ref->signs = NULL;
+}
+
+static int olderFirst(const void *a, const void *b) {
+    const struct timespec *x = &((const TileFile *)a)->used, *y = &((const TileFile *)b)->used;
+    if (x->tv_sec != y->tv_sec) return x->tv_sec < y->tv_sec ? -1 : 1;
+    return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+// Delete the least recently used tiles until they add up to maxBytes or less
+static int evictTiles(const char *dir, long long maxBytes, TileCacheStats *stats) {
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    int fd = dirfd(d);
+    TileFile *files = NULL;
+    int count = 0, cap = 0;
+    long long total = 0;
+
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        size_t len = strlen(e->d_name);
+        struct stat st;
+        if (len < 5 || len >= sizeof files->name || strcmp(e->d_name + len - 5, ".tile")) continue;
+        if (fstatat(fd, e->d_name, &st, 0) || !S_ISREG(st.st_mode)) continue;
+        if (count == cap) {
+            cap = cap ? cap*2 : 256;
+            files = realloc(files, sizeof(TileFile)*cap);
+        }
+        strcpy(files[count].name, e->d_name);
+        files[count].size = st.st_size;
+        files[count].used = st.st_mtim;
+        total += st.st_size;
+        count++;
+    }
+
+    if (total > maxBytes) {
+        qsort(files, count, sizeof(TileFile), olderFirst);
+        for (int i = 0; i < count && total > maxBytes; i++) {
+            if (!unlinkat(fd, files[i].name, 0)) {
+                total -= files[i].size;
+                stats->evicted++;
+            }
+        }
+    }
+    closedir(d);
+    free(files);
+    return 0;
+}
+
+int renderGrainCached(const GrainView *v, const char *dir, long long maxBytes, FILE *out,
+                      TileCacheStats *stats) {
+    TileCacheStats counts = { 0 };
+    if (makeDirs(dir)) return -1;
+
+    // the view's cell (x,y) is cell (x + gx0, y + gy0) of the tile grid
+    int gx0 = (int)lround(v->xOffset / (2*v->zoom)) - v->width/2;
+    int gy0 = (int)lround(v->yOffset / (2*v->zoom)) - v->height/2;
+    int tx0 = floorDiv(gx0, GRAIN_TILE), tx1 = floorDiv(gx0 + v->width - 1, GRAIN_TILE);
+    int numTiles = tx1 - tx0 + 1;
+    TileRef *row = calloc(numTiles, sizeof(TileRef));
+    int ty = 0, loaded = 0;
+
+    for (int y = 0; y < v->height; y++) {
+        int gy = gy0 + y;
+        if (!loaded || floorDiv(gy, GRAIN_TILE) != ty) {
+            // on to the next row of tiles
+            for (int t = 0; t < numTiles && loaded; t++) dropTile(&row[t]);
+            ty = floorDiv(gy, GRAIN_TILE);
+            for (int t = 0; t < numTiles; t++) row[t] = getTile(dir, v->seed, v->zoom, tx0 + t, ty, &counts);
+            loaded = 1;
+        }
+        const unsigned char *signs = NULL;
+        int tile = -1;
+        for (int x = 0; x < v->width; x++) {
+            int gx = gx0 + x;
+            if (floorDiv(gx, GRAIN_TILE) - tx0 != tile) {
+                tile = floorDiv(gx, GRAIN_TILE) - tx0;
+                signs = row[tile].signs + (gy - ty*GRAIN_TILE)*GRAIN_TILE;
+            }
+            int s = signs[gx - (tx0 + tile)*GRAIN_TILE];
+            fputs(grainSymbols[v->invert > 0 ? s & 0xf : v->invert < 0 ? s >> 4 : 0], out);
+        }
+        fputc('\n', out);
+    }
+    for (int t = 0; t < numTiles && loaded; t++) dropTile(&row[t]);
+    free(row);
+
+    int failed = evictTiles(dir, maxBytes, &counts);
+    if (stats) *stats = counts;
+    return failed;
+}
@@ -1,160 +1,429 @@
 /*
   A simple recreation of Minesweeper on the command line. Type the row number + column letter + action.
   Use . to reveal (e.g., 5a.) or ! to toggle a flag (e.g., 5a!).
+  Pass -n after the mine count for a board that can be cleared without guessing, and -p to show
+  the chance of a mine under each covered cell alongside the board.
+  With -b <games> it instead plays that many seeded games on its own (-s random|solver picks how)
+  and reports the win rate and where the time went.
+  Every game is logged to /tmp/mshistory.bin; `ms replay <log> [speed]` plays one back.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 
-#define MINE -1
-
-char *numcolors[] = {
-    "\033[0;90m",
-    "\033[0;94m",
-    "\033[32m",
-    "\033[0;91m",
-    "\033[34m",
-    "\033[31m",
-    "\033[36m",
-    "", // normally black
-    "\033[0;95m"
-};
-
-typedef struct {
-    int width, height;
-    char **board;
-    char **revealed;
-    char **flagged;
-    int mines;
-    int numRevealed;
-} MSBoard;
+#include "includes/cart_board.h"
+#include "includes/cart_screen.h"
+#include "includes/mssolver.h"
 
 #include <sys/time.h>
 
+// The biggest board that can be played by hand, and so logged: columns are typed as a-z then A-Z
+#define MAX_ROWS    9999
+#define MAX_COLUMNS 52
+
 long long get_epoch_millis(void) {
     struct timeval tv;
     gettimeofday(&tv, NULL);
     return (long long)tv.tv_sec * 1000LL + tv.tv_usec / 1000LL;
 }
 
-void refreshMineCounts(MSBoard *msb) {
-    // for each non-mine spot, put the number of mines that surround it
-    for (int y = 0; y < msb->height; y++) {
-        for (int x = 0; x < msb->width; x++) {
-            if (msb->board[y][x] == MINE) continue;
-
-            int surroundingMines = 0;
-            for (int i = -1; i <= 1; i++) {
-                for (int j = -1; j <= 1; j++) {
-                    if (i == 0 && j == 0) continue;
-                    if (i + y < 0 || i + y >= msb->height) continue;
-                    if (j + x < 0 || j + x >= msb->width) continue;
-                    if (msb->board[i+y][j+x] == MINE) surroundingMines++;
-                }
-            }
-            msb->board[y][x] = surroundingMines;
-        }
+long long get_nanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Headless play for batch runs. A strategy picks the next cell to reveal (a row-major index) from
+   what a player could see, using the scratch buffers below, which are reset between games. */
+typedef struct {
+    signed char *view, *out;
+    float *prob;
+    unsigned char *knownMine;
+    int *cells; // pending safe cells for the solver, covered cells for random
+    int numPending;
+} SimScratch;
+
+typedef int (*Strategy)(MSBoard *msb, SimScratch *s);
+
+int pickRandom(MSBoard *msb, SimScratch *s) {
+    int numCovered = 0;
+    for (int i = 0; i < msb->width * msb->height; i++) {
+        if (!(CELL(msb, i % msb->width, i / msb->width) & CELL_REVEALED)) s->cells[numCovered++] = i;
     }
+    return s->cells[rand() % numCovered];
 }
 
-void revealBoard(MSBoard *msb) {
-    for (int i = 0; i < msb->height; i++) {
-        for (int j = 0; j < msb->width; j++) {
-            msb->revealed[i][j] = 1;
-        }
+int pickSolver(MSBoard *msb, SimScratch *s) {
+    int w = msb->width, numCells = w * msb->height;
+    if (msb->numRevealed == 0) return msb->height / 2 * w + w / 2;
+
+    // Cells the last solve found safe stay safe, so use those up before solving again
+    while (s->numPending > 0) {
+        int cell = s->cells[--s->numPending];
+        if (!(CELL(msb, cell % w, cell / w) & CELL_REVEALED)) return cell;
+    }
+
+    for (int i = 0; i < numCells; i++) {
+        unsigned char cell = CELL(msb, i % w, i / w);
+        if (cell & CELL_REVEALED) s->view[i] = cell & CELL_COUNT;
+        else s->view[i] = s->knownMine[i] ? MS_MINE : MS_UNKNOWN;
     }
+    ms_solve(s->view, w, msb->height, msb->mines, s->out);
+    for (int i = 0; i < numCells; i++) {
+        if (s->view[i] != MS_UNKNOWN) continue;
+        if (s->out[i] == MS_SAFE) s->cells[s->numPending++] = i;
+        else if (s->out[i] == MS_MINE) s->knownMine[i] = 1;
+    }
+    if (s->numPending > 0) return s->cells[--s->numPending];
+
+    // Stuck, so guess the covered cell least likely to be a mine
+    ms_probabilities(s->view, w, msb->height, msb->mines, 1, s->prob);
+    int best = -1;
+    for (int i = 0; i < numCells; i++) {
+        if (s->prob[i] < 0 || s->knownMine[i]) continue;
+        if (best < 0 || s->prob[i] < s->prob[best]) best = i;
+    }
+    return best;
 }
 
-MSBoard createBoard(int width, int height, int mines) {
-    // create board
-    MSBoard msb = {
-        .width = width,
-        .height = height,
-        .mines = mines,
-        .board = malloc(sizeof(char*)*height),
-        .revealed = malloc(sizeof(char*)*height),
-        .flagged = malloc(sizeof(char*)*height),
-        .numRevealed = 0
+int runBatch(int width, int height, int mines, int noGuess, int games, unsigned int seed,
+             const char *strategyName) {
+    Strategy pick;
+    if (!strcmp(strategyName, "random")) pick = pickRandom;
+    else if (!strcmp(strategyName, "solver")) pick = pickSolver;
+    else {
+        printf("Unknown strategy '%s' (random or solver)\n", strategyName);
+        return 1;
+    }
+
+    int numCells = width * height;
+    SimScratch s = {
+        .view = malloc(numCells),
+        .out = malloc(numCells),
+        .prob = malloc(sizeof(float) * numCells),
+        .knownMine = malloc(numCells),
+        .cells = malloc(sizeof(int) * numCells)
     };
 
-    for (int i = 0; i < height; i++) {
-        msb.board[i] = calloc(width, 1);
-        msb.revealed[i] = calloc(width, 1);
-        msb.flagged[i] = calloc(width, 1);
+    // one generator thread, so each game depends only on its seed
+    long long genTime = 0, pickTime = 0, revealTime = 0;
+    long long moves = 0;
+    int wins = 0;
+    long long batchStart = get_nanos();
+
+    for (int g = 0; g < games; g++) {
+        srand(seed + g);
+        memset(s.knownMine, 0, numCells);
+        s.numPending = 0;
+
+        long long t0 = get_nanos();
+        MSBoard msb = createBoard(width, height, noGuess ? 0 : mines);
+        msb.mines = mines;
+        genTime += get_nanos() - t0;
+
+        int firstMove = 1, lost = 0;
+        while (msb.numRevealed < numCells - mines && !lost) {
+            t0 = get_nanos();
+            int cell = pick(&msb, &s);
+            long long t1 = get_nanos();
+            lost = makeMove(&msb, cell % width, cell / width, firstMove, noGuess, 1);
+            long long t2 = get_nanos();
+
+            pickTime += t1 - t0;
+            // the first move is where a board's mines get laid or moved, so it counts as generation
+            if (firstMove) genTime += t2 - t1;
+            else revealTime += t2 - t1;
+            moves++;
+            firstMove = 0;
+        }
+        if (!lost) wins++;
+        free(msb.cells);
     }
 
-    // put mines
-    for (int i = 0; i < msb.mines; i++) {
-        int x, y;
-        do {
-            x = rand() % width;
-            y = rand() % height;
-        } while (msb.board[y][x] == MINE);
-        msb.board[y][x] = MINE; // -1 = mine
-    }
+    double total = (get_nanos() - batchStart) / 1e9;
+    printf("%d games of %dx%d with %d mines%s, %s strategy, seeds %u-%u\n", games, height, width,
+           mines, noGuess ? " (no-guess)" : "", strategyName, seed, seed + games - 1);
+    printf("won:      %d (%.1f%%)\n", wins, 100.0 * wins / games);
+    printf("moves:    %lld (%.1f per game), %.0f moves/s, %.1f games/s\n", moves,
+           (double)moves / games, moves / total, games / total);
+    printf("per game: generate %.3f ms, pick %.3f ms, reveal %.3f ms (%.3f s total)\n",
+           genTime / 1e6 / games, pickTime / 1e6 / games, revealTime / 1e6 / games, total);
+
+    free(s.view);
+    free(s.out);
+    free(s.prob);
+    free(s.knownMine);
+    free(s.cells);
+    return 0;
+}
 
-    refreshMineCounts(&msb);
+/* Game history is a binary log: a header, then one event per action. Events are the milliseconds
+   since the previous event and the cell index shifted up past a 3-bit action code, both as LEB128
+   varints, so a typical event is 2-3 bytes. The mine layout is logged once it's final (after the
+   first move), which is all a replay needs to rebuild the game. */
+#define HIST_MAGIC   "MSH"
+#define HIST_VERSION 1
+#define HIST_PATH    "/tmp/mshistory.bin"
+
+#define EVENT_REVEAL 0
+#define EVENT_FLAG   1
+#define EVENT_UNFLAG 2
+#define EVENT_LAYOUT 3 // followed by the mines as a row-major bitmap, (width*height+7)/8 bytes
+
+/* Events are appended to an in-memory buffer and a writer thread puts them on disk, so the game
+   never waits on the file. Two buffers swap: the game fills one while the writer drains the other. */
+typedef struct {
+    int fd; // -1 if logging is off
+    unsigned char *buf[2];
+    size_t len[2], cap[2];
+    int active; // buffer the game is filling
+    int closing;
+    long long lastMillis;
+    pthread_mutex_t lock;
+    pthread_cond_t wake, drained;
+    pthread_t writer;
+} HistoryLog;
+
+void histPut(HistoryLog *log, unsigned char byte) {
+    int a = log->active;
+    if (log->len[a] == log->cap[a]) {
+        log->cap[a] = log->cap[a] ? log->cap[a] * 2 : 256;
+        log->buf[a] = realloc(log->buf[a], log->cap[a]);
+    }
+    log->buf[a][log->len[a]++] = byte;
+}
 
-    return msb;
+void histVarint(HistoryLog *log, unsigned long long value) {
+    // LEB128, 7 bits at a time
+    while (value >= 0x80) {
+        histPut(log, (value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    histPut(log, value);
 }
 
-int revealMine(MSBoard *msb, int x, int y) {
-    msb->revealed[y][x] = 1;
-    msb->numRevealed++;
-    if (msb->board[y][x] == MINE) return 1;
-
-    if (msb->board[y][x] > 0) return 0; 
-
-    // Flood-fill reveal all of the connecting non-mine blocks
-    for (int i = -1; i <= 1; i++) {
-        for (int j = -1; j <= 1; j++) {
-            if (i == 0 && j == 0) continue;
-            if (i + y < 0 || i + y >= msb->height) continue;
-            if (j + x < 0 || j + x >= msb->width) continue;
-            if (msb->revealed[y+i][x+j]) continue;
-            revealMine(msb, x+j, y+i);
+void *histWriter(void *arg) {
+    HistoryLog *log = arg;
+    pthread_mutex_lock(&log->lock);
+    while (1) {
+        int idle = !log->active;
+        if (log->len[idle] > 0) {
+            // the game only touches the active buffer, so this one can be written unlocked
+            pthread_mutex_unlock(&log->lock);
+            for (size_t off = 0; off < log->len[idle]; ) {
+                ssize_t n = write(log->fd, log->buf[idle] + off, log->len[idle] - off);
+                if (n <= 0) break;
+                off += n;
+            }
+            pthread_mutex_lock(&log->lock);
+            log->len[idle] = 0;
+            pthread_cond_signal(&log->drained);
+        } else if (log->closing) {
+            break;
+        } else {
+            pthread_cond_wait(&log->wake, &log->lock);
         }
     }
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+void histFlush(HistoryLog *log) {
+    // hand what's been logged to the writer, unless it's still busy with the last lot
+    if (log->fd < 0) return;
+    pthread_mutex_lock(&log->lock);
+    if (log->len[!log->active] == 0 && log->len[log->active] > 0) {
+        log->active = !log->active;
+        pthread_cond_signal(&log->wake);
+    }
+    pthread_mutex_unlock(&log->lock);
+}
 
+int histOpen(HistoryLog *log, const char *path, MSBoard *msb, int flags) {
+    *log = (HistoryLog){ .fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) };
+    if (log->fd < 0) return 1;
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->wake, NULL);
+    pthread_cond_init(&log->drained, NULL);
+    pthread_create(&log->writer, NULL, histWriter, log);
+
+    for (const char *m = HIST_MAGIC; *m; m++) histPut(log, *m);
+    histPut(log, HIST_VERSION);
+    histVarint(log, msb->width);
+    histVarint(log, msb->height);
+    histVarint(log, msb->mines);
+    histVarint(log, flags);
+    log->lastMillis = get_epoch_millis();
     return 0;
 }
 
-void printBoard(MSBoard msb) {
-    printf("   | ");
-    for (int i = 0; i < msb.width; i++) {
-        printf("%c ", i >= 26 ? 'A' + i-26 : 'a' + i);
+void histEvent(HistoryLog *log, int action, int cell) {
+    if (log->fd < 0) return;
+    long long now = get_epoch_millis();
+    histVarint(log, now - log->lastMillis);
+    histVarint(log, (unsigned long long)cell << 3 | action);
+    log->lastMillis = now;
+}
+
+void histLayout(HistoryLog *log, MSBoard *msb) {
+    if (log->fd < 0) return;
+    histEvent(log, EVENT_LAYOUT, 0);
+    unsigned char bits = 0;
+    int i;
+    for (i = 0; i < msb->width * msb->height; i++) {
+        if (CELL(msb, i % msb->width, i / msb->width) & CELL_MINE) bits |= 1 << (i & 7);
+        if ((i & 7) == 7) {
+            histPut(log, bits);
+            bits = 0;
+        }
+    }
+    if (i & 7) histPut(log, bits);
+}
+
+void histClose(HistoryLog *log) {
+    // write out everything still buffered and stop the writer
+    if (log->fd < 0) return;
+    pthread_mutex_lock(&log->lock);
+    while (log->len[log->active] > 0) {
+        while (log->len[!log->active] > 0) pthread_cond_wait(&log->drained, &log->lock);
+        log->active = !log->active;
+        pthread_cond_signal(&log->wake);
+    }
+    log->closing = 1;
+    pthread_cond_signal(&log->wake);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->writer, NULL);
+    close(log->fd);
+    free(log->buf[0]);
+    free(log->buf[1]);
+}
+
+int getVarint(const unsigned char **p, const unsigned char *end, unsigned long long *value) {
+    *value = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char byte = *(*p)++;
+        *value |= (unsigned long long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return 0;
     }
-    printf("\n---+");
-    for (int i = 0; i < msb.width; i++) {
-        printf("--");
+    return 1;
+}
+
+int replayGame(const char *path, double speed) {
+    // Play a history log back, redrawing after each event; speed 0 skips the waits
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        printf("Failed to open %s\n", path);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    unsigned char *data = malloc(size > 0 ? size : 1);
+    size_t got = fread(data, 1, size, fp);
+    fclose(fp);
+    const unsigned char *p = data, *end = data + got;
+
+    unsigned long long width, height, mines, flags;
+    int bad = got < 4 || memcmp(p, HIST_MAGIC, 3) || p[3] != HIST_VERSION;
+    if (!bad) {
+        p += 4;
+        bad = getVarint(&p, end, &width) || getVarint(&p, end, &height) ||
+              getVarint(&p, end, &mines) || getVarint(&p, end, &flags) ||
+              width == 0 || height == 0 || width > MAX_COLUMNS || height > MAX_ROWS ||
+              mines >= width * height;
     }
-    printf("\n");
+    if (bad) {
+        printf("%s is not a history log this version can read\n", path);
+        free(data);
+        return 1;
+    }
+
+    MSBoard msb = allocBoard(width, height);
+    msb.mines = mines;
+    int numCells = width * height;
+    Screen scr = { 0 };
+    long long millis = 0;
+    int gameLost = 0;
+    drawBoard(&scr, &msb, NULL);
 
-    for (int y = 0; y < msb.height; y++) {
-        for (int x =  0; x < msb.width; x++) {
-            if (x == 0) {
-                printf("%2i | ", y+1);
+    while (p < end && !gameLost) {
+        unsigned long long delta, code;
+        if (getVarint(&p, end, &delta) || getVarint(&p, end, &code) || (code >> 3) >= (unsigned)numCells) {
+            printf("Log is truncated or corrupt\n");
+            break;
+        }
+        int cell = code >> 3, action = code & 7;
+        int x = cell % msb.width, y = cell / msb.width;
+        millis += delta;
+        if (speed > 0) usleep(delta * 1000 / speed);
+
+        if (action == EVENT_LAYOUT) {
+            if (end - p < (numCells + 7) / 8) {
+                printf("Log is truncated or corrupt\n");
+                break;
             }
-            if (msb.flagged[y][x]) {
-               printf("\033[31mF\033[0m ");
-            } else if (msb.revealed[y][x]) {
-                if (msb.board[y][x] == -1) printf("M ");
-                else printf("%s%i\033[0m ", numcolors[msb.board[y][x]], msb.board[y][x]);
-            } else {
-                printf("* ");
+            for (int i = 0; i < numCells; i++) {
+                if (p[i >> 3] >> (i & 7) & 1) placeMine(&msb, i % msb.width, i / msb.width);
             }
+            p += (numCells + 7) / 8;
+            continue;
         }
-        printf("\n");
+
+        const char *what = "reveal";
+        if (action == EVENT_FLAG || action == EVENT_UNFLAG) {
+            CELL(&msb, x, y) ^= CELL_FLAGGED;
+            what = action == EVENT_FLAG ? "flag" : "unflag";
+        } else if (revealMine(&msb, x, y)) {
+            revealBoard(&msb);
+            gameLost = 1;
+        }
+        drawBoard(&scr, &msb, NULL);
+        printf("%8.3f  %s %i%c\n", millis / 1000.0, what, y+1, x >= 26 ? 'A' + x-26 : 'a' + x);
+        fflush(stdout);
     }
-}
 
-#define SINCE ((float)(get_epoch_millis() - startTime) / 1000.0)
+    if (gameLost) printf("Mine triggered, game over!\n");
+    else if (msb.numRevealed == numCells - msb.mines) printf("Board cleared, you won!\n");
+    else printf("Game was left unfinished\n");
+    free(msb.cells);
+    freeScreen(&scr);
+    free(data);
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        printf("Usage: %s <rows> <columns> <mines>\n", argv[0]);
+    if (argc >= 3 && !strcmp(argv[1], "replay")) return replayGame(argv[2], argc > 3 ? atof(argv[3]) : 1);
+
+    int noGuess = 0, showHeat = 0, badFlag = 0;
+    int games = 0;
+    unsigned int seed = 1;
+    const char *strategy = "solver";
+    for (int i = 4; i < argc; i++) {
+        if (!strcmp(argv[i], "-n")) noGuess = 1;
+        else if (!strcmp(argv[i], "-p")) showHeat = 1;
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc) games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc) strategy = argv[++i];
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc) seed = strtoul(argv[++i], NULL, 10);
+        else badFlag = 1;
+    }
+    if (argc < 4 || badFlag) {
+        printf("Usage: %s <rows> <columns> <mines> [-n] [-p] [-b <games> [-s <strategy>] [-r <seed>]]\n",
+               argv[0]);
         printf("Example: %s 16 30 99\n", argv[0]);
+        printf("  -n: no-guess board, solvable from the first click by logic alone\n");
+        printf("  -p: show each covered cell's chance of being a mine next to the board\n"
+               "      (tenths; - is certainly safe, ! is certainly a mine)\n");
+        printf("  -b: play this many games headless and report win rate and timings\n"
+               "  -s: strategy for -b, random or solver (default)\n"
+               "  -r: seed of the first game for -b, default 1; game i uses seed + i\n");
+        printf("       %s replay <log> [speed]\n", argv[0]);
+        printf("  play back a game's history log, e.g. %s, at speed times real time\n"
+               "  (default 1, 0 for no waiting)\n", HIST_PATH);
         return 1;
     }
 
@@ -172,24 +441,35 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    FILE *histfp = fopen("/tmp/mshistory.txt", "w");
-    if (!histfp) {
-        printf("Failed to open history file");
+    if (games > 0) return runBatch(width, height, mines, noGuess, games, seed, strategy);
+
+    if (height > MAX_ROWS || width > MAX_COLUMNS) {
+        printf("Error: a game played by hand can have at most %d rows and %d columns\n", MAX_ROWS,
+               MAX_COLUMNS);
+        return 1;
     }
 
     srand(time(0));
-    MSBoard msb = createBoard(width, height, mines);
+    MSBoard msb = createBoard(width, height, noGuess ? 0 : mines);
+    msb.mines = mines;
+
+    HistoryLog hist;
+    if (histOpen(&hist, HIST_PATH, &msb, noGuess)) {
+        printf("Failed to open history file %s, this game won't be logged\n", HIST_PATH);
+    }
     
     int numCells = msb.width * msb.height;
     int revealedGoal = numCells - msb.mines;
     int gameLost = 0;
     int firstMove = 1;
 
-    long long startTime = get_epoch_millis();
+    float *heat = showHeat ? malloc(sizeof(float) * numCells) : NULL;
+
+    Screen scr = { 0 };
 
     while (msb.numRevealed < revealedGoal) {
-        printf("\033[2J\033[H");
-        printBoard(msb);
+        if (heat) heatmap(&msb, heat);
+        drawBoard(&scr, &msb, heat);
         int x, row;
         while (1) {
             printf("Enter a slot: [row][column][action] (. to reveal, ! to flag):\n");
@@ -223,82 +503,46 @@ int main(int argc, char *argv[]) {
                 printf("Column out of range.\n");
                 continue;
             }
-            if (msb.revealed[row-1][x]) {
+            unsigned char *cell = &CELL(&msb, x, row-1);
+            if (*cell & CELL_REVEALED) {
                 printf("Cell already revealed.\n");
                 continue;
             }
             
             if (action == '!') {
-                msb.flagged[row-1][x] = !msb.flagged[row-1][x];
-                if (msb.flagged[row-1][x]) {
-                    fprintf(histfp, "%.3f Flag: %i%c\n", SINCE, row, col);
-                } else {
-                    fprintf(histfp, "%.3f Unflag: %i%c\n", SINCE, row, col);
-                }
+                *cell ^= CELL_FLAGGED;
+                histEvent(&hist, *cell & CELL_FLAGGED ? EVENT_FLAG : EVENT_UNFLAG, (row-1)*msb.width + x);
                 break;
             }
             
-            if (msb.flagged[row-1][x]) {
+            if (*cell & CELL_FLAGGED) {
                 printf("Cell is flagged. Unflag first.\n");
                 continue;
             }
 
-            fprintf(histfp, "%.3f Move: %i%c\n", SINCE, row, col);
-            
-            int result = revealMine(&msb, x, row-1);
-            if (result) {
-                if (firstMove) {
-                    // Clear the clicked cell
-                    msb.board[row-1][x] = 0;
-                    
-                    // Clear and relocate all surrounding mines
-                    for (int i = -1; i <= 1; i++) {
-                        for (int j = -1; j <= 1; j++) {
-                            if (i == 0 && j == 0) continue;
-                            int ny = row-1 + i;
-                            int nx = x + j;
-                            if (ny < 0 || ny >= msb.height) continue;
-                            if (nx < 0 || nx >= msb.width) continue;
-                            
-                            // If this cell was a mine, relocate it
-                            if (msb.board[ny][nx] == MINE) {
-                                msb.board[ny][nx] = 0;
-                                
-                                // Find new location outside the 3x3 area
-                                int Nx, Ny;
-                                do {
-                                    Nx = rand() % msb.width;
-                                    Ny = rand() % msb.height;
-                                } while (msb.board[Ny][Nx] == MINE || 
-                                         (Nx >= x-1 && Nx <= x+1 && Ny >= row-2 && Ny <= row));
-                                msb.board[Ny][Nx] = MINE;
-                            }
-                        }
-                    }
-
-                    refreshMineCounts(&msb);
-                    revealMine(&msb, x, row-1);
-                } else {
-                    revealBoard(&msb);
-                    printf("\033[2J\033[H");
-                    printBoard(msb);
-                    fprintf(histfp, "%.3f Mine triggered at %i%c\n", SINCE, row, col);
-                    printf("Mine triggered, game over!\n");
-                    gameLost = 1;
-                }
+            int threads = sysconf(_SC_NPROCESSORS_ONLN);
+            int hitMine = makeMove(&msb, x, row-1, firstMove, noGuess, threads);
+            // the layout is only final once the first move has been made
+            if (firstMove) histLayout(&hist, &msb);
+            histEvent(&hist, EVENT_REVEAL, (row-1)*msb.width + x);
+            firstMove = 0;
+            if (hitMine) {
+                revealBoard(&msb);
+                drawBoard(&scr, &msb, NULL);
+                printf("Mine triggered, game over!\n");
+                gameLost = 1;
             }
             break;
         }
-        firstMove = 0;
+        histFlush(&hist);
         if (gameLost) break;
     }
 
     if (!gameLost) {
         revealBoard(&msb);
-        printBoard(msb);
-        fprintf(histfp, "%.3f Board cleared\n", SINCE);
+        drawBoard(&scr, &msb, NULL);
         printf("Board cleared, you won!\n");
     }
-    printf("Game history output to /tmp/mshistory.txt\n");
-    fclose(histfp);
+    histClose(&hist);
+    if (hist.fd >= 0) printf("Game history output to %s (%s replay %s to watch it again)\n", HIST_PATH, argv[0], HIST_PATH);
 }
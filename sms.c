@@ -6,246 +6,386 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "includes/cart_board.h"
+#include "includes/mssolver.h"
+
+void printBoard(MSBoard msb, const float *heat) {
+    // heat, if given, is drawn as a second grid to the right (see heatmap())
+    for (int pass = 0; pass < (heat ? 2 : 1); pass++) {
+        printf(pass ? " " : "   | ");
+        for (int i = 0; i < msb.width; i++) {
+            printf("%c ", i >= 26 ? 'A' + i-26 : 'a' + i);
+        }
+    }
+    printf("\n---+");
+    for (int i = 0; i < msb.width * (heat ? 2 : 1); i++) {
+        printf("--");
+    }
+    printf("\n");
+
+    for (int y = 0; y < msb.height; y++) {
+        for (int x =  0; x < msb.width; x++) {
+            if (x == 0) {
+                printf("%2i | ", y+1);
+            }
+            unsigned char cell = CELL(&msb, x, y);
+            if (cell & CELL_FLAGGED) {
+               //printf("\033[31mF\033[0m ");
+               printf("F ");
+            } else if (cell & CELL_REVEALED) {
+                if (cell & CELL_MINE) printf("M ");
+                else printf("%i ", cell & CELL_COUNT);
+            } else {
+                printf("* ");
+            }
+        }
+        if (heat) {
+            printf(" ");
+            for (int x = 0; x < msb.width; x++) {
+                float p = heat[y*msb.width + x];
+                if (p < 0) printf("  ");
+                else if (p == 0) printf("- ");
+                else if (p == 1) printf("! ");
+                else printf("%i ", p >= 0.9 ? 9 : (int)(p * 10));
+            }
+        }
+        printf("\n");
+    }
+}
+
+void printHint(MSBoard *msb) {
+    // Run the solver on what the player can see (flags aren't trusted) and list what it proves
+    int numCells = msb->width * msb->height;
+    signed char *view = malloc(numCells);
+    boardView(msb, view);
+
+    int decided = msb->numRevealed == 0 ? 0 : ms_solve(view, msb->width, msb->height, msb->mines, view);
+    if (msb->numRevealed == 0) {
+        printf("Any cell is safe on the first move.\n");
+    } else if (decided < 0) {
+        printf("Not enough memory to work out a hint.\n");
+    } else if (decided == 0) {
+        printf("No certain move, you'll have to guess.\n");
+    } else {
+        for (int pass = 0; pass < 2; pass++) {
+            printf(pass == 0 ? "Safe:" : "Mines:");
+            for (int i = 0; i < numCells; i++) {
+                if (view[i] != (pass == 0 ? MS_SAFE : MS_MINE)) continue;
+                int x = i % msb->width;
+                printf(" %i%c", i / msb->width + 1, x >= 26 ? 'A' + x-26 : 'a' + x);
+            }
+            printf("\n");
+        }
+    }
+    free(view);
+}
 
-#define MINE -1
+void usage() {
+    printf("Usage: sms new [rows] [cols] [mine count] [-n]\n"
+           "       sms move [row] [col]\n"
+           "       sms flag [row] [col]\n"
+           "       sms hint\n"
+           "       sms heat\n"
+           "       sms save [file]\n"
+           "       sms load [file]\n"
+           "       (row is a number, col is a letter a-z, -n makes a no-guess board)\n");
+}
+
+/* The gamestate file is a small header followed by the packed cells exactly as they sit in memory,
+   border included. It is mmap'ed and played on in place, so a move only dirties the pages holding
+   the cells it changes instead of rewriting the whole board. */
+#define GAMESTATE_MAGIC   0x474d5353 // "SSMG" on disk
+#define GAMESTATE_VERSION 2          // version 1 was the old headerless byte-plane layout
 
 typedef struct {
+    unsigned int magic;
+    unsigned int version;
     int width, height;
-    char **board;
-    char **revealed;
-    char **flagged;
     int mines;
     int numRevealed;
-} MSBoard;
-
-void refreshMineCounts(MSBoard *msb) {
-    // for each non-mine spot, put the number of mines that surround it
-    for (int y = 0; y < msb->height; y++) {
-        for (int x = 0; x < msb->width; x++) {
-            if (msb->board[y][x] == MINE) continue;
-
-            int surroundingMines = 0;
-            for (int i = -1; i <= 1; i++) {
-                for (int j = -1; j <= 1; j++) {
-                    if (i == 0 && j == 0) continue;
-                    if (i + y < 0 || i + y >= msb->height) continue;
-                    if (j + x < 0 || j + x >= msb->width) continue;
-                    if (msb->board[i+y][j+x] == MINE) surroundingMines++;
-                }
-            }
-            msb->board[y][x] = surroundingMines;
-        }
+    unsigned int flags;
+    unsigned int checksum; // over all of the fields above
+} GamestateHeader;
+
+#define GAMESTATE_NOGUESS 1 // mines are laid by placeNoGuessMines() on the first move
+
+unsigned int headerChecksum(GamestateHeader *hdr) {
+    // FNV-1a
+    unsigned char *bytes = (unsigned char *)hdr;
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(GamestateHeader, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
     }
+    return hash;
+}
+
+size_t gamestateSize(int width, int height) {
+    return sizeof(GamestateHeader) + (size_t)(width + 2) * (height + 2);
 }
 
-MSBoard createBoard(int width, int height, int mines) {
-    // create board
-    MSBoard msb = {
-        .width = width,
-        .height = height,
-        .mines = mines,
-        .board = malloc(sizeof(char*)*height),
-        .revealed = malloc(sizeof(char*)*height),
-        .flagged = malloc(sizeof(char*)*height),
-        .numRevealed = 0
+int writeGamestate(MSBoard msb, unsigned int flags, const char *path) {
+    GamestateHeader hdr = {
+        .magic = GAMESTATE_MAGIC,
+        .version = GAMESTATE_VERSION,
+        .width = msb.width,
+        .height = msb.height,
+        .mines = msb.mines,
+        .numRevealed = msb.numRevealed,
+        .flags = flags
     };
+    hdr.checksum = headerChecksum(&hdr);
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return 1;
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    fwrite(msb.cells, 1, (size_t)msb.stride * (msb.height + 2), fp);
+    return fclose(fp) != 0;
+}
 
-    for (int i = 0; i < height; i++) {
-        msb.board[i] = calloc(width, 1);
-        msb.revealed[i] = calloc(width, 1);
-        msb.flagged[i] = calloc(width, 1);
+int mapGamestate(MSBoard *msb, const char *path) {
+    // Map the gamestate file and point msb at the cells inside it. Returns nonzero on failure.
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        printf("No game in progress, start one with 'sms new'.\n");
+        return 1;
     }
 
-    // put mines
-    for (int i = 0; i < msb.mines; i++) {
-        int x, y;
-        do {
-            x = rand() % width;
-            y = rand() % height;
-        } while (msb.board[y][x] == MINE);
-        msb.board[y][x] = MINE; // -1 = mine
+    struct stat st;
+    GamestateHeader *hdr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(GamestateHeader)) {
+        hdr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     }
+    close(fd);
 
-    refreshMineCounts(&msb);
+    if (hdr == MAP_FAILED || hdr->magic != GAMESTATE_MAGIC || hdr->version != GAMESTATE_VERSION
+        || hdr->checksum != headerChecksum(hdr) || hdr->width < 2 || hdr->height < 2
+        || (size_t)st.st_size != gamestateSize(hdr->width, hdr->height)) {
+        printf("The gamestate file is corrupt or from an older version, start a new game with 'sms new'.\n");
+        if (hdr != MAP_FAILED) munmap(hdr, st.st_size);
+        return 1;
+    }
 
-    return msb;
+    msb->width = hdr->width;
+    msb->height = hdr->height;
+    msb->stride = hdr->width + 2;
+    msb->cells = (unsigned char *)(hdr + 1);
+    msb->mines = hdr->mines;
+    msb->numRevealed = hdr->numRevealed;
+    return 0;
 }
 
-void revealAll(MSBoard *msb) {
-    for (int i = 0; i < msb->height; i++) {
-        for (int j = 0; j < msb->width; j++) {
-            msb->revealed[i][j] = 1;
-        }
-    }
+GamestateHeader *gamestateHeader(MSBoard *msb) {
+    return (GamestateHeader *)msb->cells - 1;
 }
 
-void clearFirstMoveArea(MSBoard *msb, int x, int y) {
-    // Check all cells in 3x3 grid centered on (x,y)
-    for (int i = -1; i <= 1; i++) {
-        for (int j = -1; j <= 1; j++) {
-            int checkY = y + i;
-            int checkX = x + j;
-            
-            // Skip if out of bounds
-            if (checkY < 0 || checkY >= msb->height) continue;
-            if (checkX < 0 || checkX >= msb->width) continue;
-            
-            // If there's a mine here, relocate it
-            if (msb->board[checkY][checkX] == MINE) {
-                msb->board[checkY][checkX] = 0; // Remove mine
-                
-                // Find a new random location outside the 3x3 grid
-                int newX, newY;
-                int attempts = 0;
-                do {
-                    newX = rand() % msb->width;
-                    newY = rand() % msb->height;
-                    attempts++;
-                    
-                    // Check if this position is outside the 3x3 grid and not already a mine
-                    int outsideGrid = (newY < y - 1 || newY > y + 1 || 
-                                      newX < x - 1 || newX > x + 1);
-                    int notMine = (msb->board[newY][newX] != MINE);
-                    
-                    if (outsideGrid && notMine) break;
-                    
-                    // Safety check to prevent infinite loop
-                    if (attempts > 1000) return;
-                } while (1);
-                
-                msb->board[newY][newX] = MINE;
-            }
-        }
-    }
-    
-    // Recalculate all mine counts after relocating
-    refreshMineCounts(msb);
+void unmapGamestate(MSBoard *msb) {
+    // Cell changes are already in the file, only the header needs bringing up to date
+    GamestateHeader *hdr = gamestateHeader(msb);
+    hdr->numRevealed = msb->numRevealed;
+    hdr->checksum = headerChecksum(hdr);
+    munmap(hdr, gamestateSize(msb->width, msb->height));
+    msb->cells = NULL;
 }
 
-int revealMine(MSBoard *msb, int x, int y) {
-    // If this is the first move, ensure the 3x3 area is clear
-    if (msb->numRevealed == 0) {
-        clearFirstMoveArea(msb, x, y);
-    }
-    
-    msb->revealed[y][x] = 1;
-    msb->numRevealed++;
-    if (msb->board[y][x] == MINE) return 1;
-
-    if (msb->board[y][x] > 0) return 0; 
-
-    // Flood-fill reveal all of the connecting non-mine blocks
-    for (int i = -1; i <= 1; i++) {
-        for (int j = -1; j <= 1; j++) {
-            if (i == 0 && j == 0) continue;
-            if (i + y < 0 || i + y >= msb->height) continue;
-            if (j + x < 0 || j + x >= msb->width) continue;
-            if (msb->revealed[y+i][x+j]) continue;
-            revealMine(msb, x+j, y+i);
-        }
-    }
+/* Saved games ('sms save'/'sms load') are for keeping and moving games around rather than playing
+   on, so they are packed down: counts are left out since they follow from the mines, and the mine,
+   revealed and flagged planes are bitsets, each run-length encoded when that comes out smaller.
+   A fresh game is almost all zeros in two of the three planes, so those shrink to a few bytes. */
+#define ARCHIVE_MAGIC   0x41534d53 // "SMSA" on disk
+#define ARCHIVE_VERSION 2 // version 1 didn't keep the gamestate flags
 
-    return 0;
+enum { PLANE_RAW, PLANE_RLE };
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    int width, height;
+    int mines;
+    unsigned int flags;    // the gamestate's, so a no-guess game still gets its mines on load
+    unsigned int checksum; // FNV-1a of everything after the header
+} ArchiveHeader;
+
+typedef struct {
+    unsigned char *data;
+    size_t len, cap;
+} ByteBuf;
+
+void putByte(ByteBuf *buf, unsigned char byte) {
+    if (buf->len == buf->cap) {
+        buf->cap = buf->cap ? buf->cap * 2 : 256;
+        buf->data = realloc(buf->data, buf->cap);
+    }
+    buf->data[buf->len++] = byte;
 }
 
-void printBoard(MSBoard msb) {
-    printf("   | ");
-    for (int i = 0; i < msb.width; i++) {
-        printf("%c ", i >= 26 ? 'A' + i-26 : 'a' + i);
+void putVarint(ByteBuf *buf, size_t value) {
+    // LEB128, 7 bits at a time
+    while (value >= 0x80) {
+        putByte(buf, (value & 0x7f) | 0x80);
+        value >>= 7;
     }
-    printf("\n---+");
-    for (int i = 0; i < msb.width; i++) {
-        printf("--");
+    putByte(buf, value);
+}
+
+int getVarint(const unsigned char **p, const unsigned char *end, size_t *value) {
+    *value = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char byte = *(*p)++;
+        *value |= (size_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return 0;
     }
-    printf("\n");
+    return 1;
+}
 
-    for (int y = 0; y < msb.height; y++) {
-        for (int x =  0; x < msb.width; x++) {
-            if (x == 0) {
-                printf("%2i | ", y+1);
+void putPlane(ByteBuf *out, MSBoard *msb, unsigned char mask) {
+    // Build both encodings of the plane and keep the smaller one
+    ByteBuf raw = {0}, rle = {0};
+    unsigned char bits = 0;
+    int runBit = 0;
+    size_t run = 0, i = 0;
+
+    for (int y = 0; y < msb->height; y++) {
+        for (int x = 0; x < msb->width; x++, i++) {
+            int bit = !!(CELL(msb, x, y) & mask);
+            bits |= bit << (i & 7);
+            if ((i & 7) == 7) {
+                putByte(&raw, bits);
+                bits = 0;
             }
-            if (msb.flagged[y][x]) {
-               //printf("\033[31mF\033[0m ");
-               printf("F ");
-            } else if (msb.revealed[y][x]) {
-                if (msb.board[y][x] == -1) printf("M ");
-                else printf("%i ", msb.board[y][x]);
-            } else {
-                printf("* ");
+            // runs alternate starting with a run of zeros, which may be empty
+            if (bit != runBit) {
+                putVarint(&rle, run);
+                runBit = bit;
+                run = 0;
             }
+            run++;
         }
-        printf("\n");
     }
-}
+    if (i & 7) putByte(&raw, bits);
+    putVarint(&rle, run);
 
-void usage() {
-    printf("Usage: sms new [rows] [cols] [mine count]\n"
-           "       sms move [row] [col]\n"
-           "       sms flag [row] [col]\n"
-           "       (row is a number, col is a letter a-z)\n");
-}
-
-void writeMSBToFile(MSBoard msb, FILE *fp) {
-    // Write integers
-    fwrite(&msb.width, sizeof(int), 1, fp);
-    fwrite(&msb.height, sizeof(int), 1, fp);
-    fwrite(&msb.mines, sizeof(int), 1, fp);
-    fwrite(&msb.numRevealed, sizeof(int), 1, fp);
+    ByteBuf *pick = rle.len < raw.len ? &rle : &raw;
+    putByte(out, pick == &rle ? PLANE_RLE : PLANE_RAW);
+    putVarint(out, pick->len);
+    for (size_t j = 0; j < pick->len; j++) putByte(out, pick->data[j]);
 
-    // Write board array (mine positions and counts)
-    for (int i = 0; i < msb.height; i++) {
-        fwrite(msb.board[i], sizeof(char), msb.width, fp);
-    }
+    free(raw.data);
+    free(rle.data);
+}
 
-    // Write revealed array
-    for (int i = 0; i < msb.height; i++) {
-        fwrite(msb.revealed[i], sizeof(char), msb.width, fp);
+int getPlane(const unsigned char **p, const unsigned char *end, MSBoard *msb, unsigned char mask) {
+    // Decode a plane and set mask on each cell whose bit is set. Returns nonzero if malformed.
+    size_t numCells = (size_t)msb->width * msb->height, len;
+    if (*p >= end) return 1;
+    int encoding = *(*p)++;
+    if (getVarint(p, end, &len) || len > (size_t)(end - *p)) return 1;
+    const unsigned char *data = *p, *dataEnd = *p + len;
+    *p = dataEnd;
+
+    if (encoding == PLANE_RAW) {
+        if (len != (numCells + 7) / 8) return 1;
+        for (size_t i = 0; i < numCells; i++) {
+            if (data[i >> 3] >> (i & 7) & 1) {
+                int x = i % msb->width, y = i / msb->width;
+                if (mask == CELL_MINE) placeMine(msb, x, y);
+                else CELL(msb, x, y) |= mask;
+            }
+        }
+        return 0;
     }
-
-    // Write flagged array
-    for (int i = 0; i < msb.height; i++) {
-        fwrite(msb.flagged[i], sizeof(char), msb.width, fp);
+    if (encoding != PLANE_RLE) return 1;
+
+    size_t i = 0;
+    for (int bit = 0; data < dataEnd; bit = !bit) {
+        size_t run;
+        if (getVarint(&data, dataEnd, &run) || run > numCells - i) return 1;
+        for (size_t stop = i + run; bit && i < stop; i++) {
+            int x = i % msb->width, y = i / msb->width;
+            if (mask == CELL_MINE) placeMine(msb, x, y);
+            else CELL(msb, x, y) |= mask;
+        }
+        if (!bit) i += run;
     }
+    return i != numCells;
 }
 
-MSBoard readMSBFromFile(FILE *fp) {
-    MSBoard msb;
-
-    // Read integers
-    fread(&msb.width, sizeof(int), 1, fp);
-    fread(&msb.height, sizeof(int), 1, fp);
-    fread(&msb.mines, sizeof(int), 1, fp);
-    fread(&msb.numRevealed, sizeof(int), 1, fp);
-
-    // Allocate memory for arrays
-    msb.board = malloc(sizeof(char*) * msb.height);
-    msb.revealed = malloc(sizeof(char*) * msb.height);
-    msb.flagged = malloc(sizeof(char*) * msb.height);
-
-    for (int i = 0; i < msb.height; i++) {
-        msb.board[i] = malloc(sizeof(char) * msb.width);
-        msb.revealed[i] = malloc(sizeof(char) * msb.width);
-        msb.flagged[i] = malloc(sizeof(char) * msb.width);
+int saveArchive(MSBoard *msb, unsigned int flags, const char *path) {
+    ByteBuf body = {0};
+    putPlane(&body, msb, CELL_MINE);
+    putPlane(&body, msb, CELL_REVEALED);
+    putPlane(&body, msb, CELL_FLAGGED);
+
+    ArchiveHeader hdr = {
+        .magic = ARCHIVE_MAGIC,
+        .version = ARCHIVE_VERSION,
+        .width = msb->width,
+        .height = msb->height,
+        .mines = msb->mines,
+        .flags = flags,
+        .checksum = 2166136261u
+    };
+    for (size_t i = 0; i < body.len; i++) {
+        hdr.checksum = (hdr.checksum ^ body.data[i]) * 16777619u;
     }
 
-    // Read board array (mine positions and counts)
-    for (int i = 0; i < msb.height; i++) {
-        fread(msb.board[i], sizeof(char), msb.width, fp);
+    FILE *fp = fopen(path, "wb");
+    int failed = !fp;
+    if (fp) {
+        fwrite(&hdr, sizeof(hdr), 1, fp);
+        fwrite(body.data, 1, body.len, fp);
+        failed = fclose(fp) != 0;
     }
+    free(body.data);
+    return failed;
+}
 
-    // Read revealed array
-    for (int i = 0; i < msb.height; i++) {
-        fread(msb.revealed[i], sizeof(char), msb.width, fp);
+int loadArchive(MSBoard *msb, unsigned int *flags, const char *path) {
+    // Rebuild a full board and its gamestate flags from a saved game. Returns nonzero on failure.
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        printf("Can't open %s.\n", path);
+        return 1;
+    }
+    ArchiveHeader hdr;
+    ByteBuf body = {0};
+    size_t got = fread(&hdr, 1, sizeof(hdr), fp);
+    int c;
+    while ((c = getc(fp)) != EOF) putByte(&body, c);
+    fclose(fp);
+
+    unsigned int checksum = 2166136261u;
+    for (size_t i = 0; i < body.len; i++) {
+        checksum = (checksum ^ body.data[i]) * 16777619u;
     }
 
-    // Read flagged array
-    for (int i = 0; i < msb.height; i++) {
-        fread(msb.flagged[i], sizeof(char), msb.width, fp);
+    int failed = got != sizeof(hdr) || hdr.magic != ARCHIVE_MAGIC || hdr.version != ARCHIVE_VERSION
+                 || hdr.checksum != checksum || hdr.width < 2 || hdr.height < 2;
+    if (!failed) {
+        *msb = allocBoard(hdr.width, hdr.height);
+        msb->mines = hdr.mines;
+        *flags = hdr.flags;
+        const unsigned char *p = body.data, *end = body.data + body.len;
+        failed = getPlane(&p, end, msb, CELL_MINE) || getPlane(&p, end, msb, CELL_REVEALED)
+                 || getPlane(&p, end, msb, CELL_FLAGGED);
+        for (int y = 0; !failed && y < msb->height; y++) {
+            for (int x = 0; x < msb->width; x++) {
+                if (CELL(msb, x, y) & CELL_REVEALED) msb->numRevealed++;
+            }
+        }
+        if (failed) free(msb->cells);
     }
+    if (failed) printf("%s is not a valid saved game.\n", path);
 
-    return msb;
+    free(body.data);
+    return failed;
 }
 
 int main(int argc, char **argv) {
@@ -255,7 +395,6 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    FILE *gsfp;
     MSBoard msb;
 
     if (!strcmp(argv[1], "new")) {
@@ -268,19 +407,22 @@ int main(int argc, char **argv) {
         int cols = atoi(argv[3]);
         int minecount = atoi(argv[4]);
 
-        if (rows < 2 || cols < 2 || minecount < 1) {
+        if (rows < 2 || cols < 2 || minecount < 1 || minecount >= rows * cols) {
             printf("Invalid game setup.\n");
             return 1;
         }
 
         printf("Starting new game. Use 'sms move [row] [col]' to play (row is a number, col is a letter).\n");
 
+        int noGuess = argc > 5 && !strcmp(argv[5], "-n");
         srand(time(0));
-        msb = createBoard(cols, rows, minecount);
+        msb = createBoard(cols, rows, noGuess ? 0 : minecount);
+        msb.mines = minecount;
 
-        gsfp = fopen("gamestate", "wb");
-        writeMSBToFile(msb, gsfp);
-        fclose(gsfp);
+        if (writeGamestate(msb, noGuess ? GAMESTATE_NOGUESS : 0, "gamestate")) {
+            printf("Failed to write gamestate file.\n");
+            return 1;
+        }
 
     } else if (!strcmp(argv[1], "move")) {
         if (argc < 4) {
@@ -288,9 +430,7 @@ int main(int argc, char **argv) {
             return 1;
         }
 
-        gsfp = fopen("gamestate", "rb");
-        msb = readMSBFromFile(gsfp);
-        fclose(gsfp);
+        if (mapGamestate(&msb, "gamestate")) return 1;
 
         int numCells = msb.width * msb.height;
         int revealedGoal = numCells - msb.mines;
@@ -319,15 +459,25 @@ int main(int argc, char **argv) {
             return 1;
         }
 
+        GamestateHeader *hdr = gamestateHeader(&msb);
+        if (hdr->flags & GAMESTATE_NOGUESS) {
+            srand(time(0));
+            placeNoGuessMines(&msb, x, row-1, sysconf(_SC_NPROCESSORS_ONLN));
+            hdr->flags &= ~GAMESTATE_NOGUESS;
+        }
+
+        // The first move always opens up an area
+        if (msb.numRevealed == 0) clearFirstMoveArea(&msb, x, row-1);
         int result = revealMine(&msb, x, row-1);
         if (result) {
-            revealAll(&msb);
+            revealBoard(&msb);
             gameLost = 1;
         } else if (revealedGoal == msb.numRevealed) {
             // Win condition - all safe cells revealed
-            revealAll(&msb);
-            printBoard(msb);
+            revealBoard(&msb);
+            printBoard(msb, NULL);
             printf("Board cleared, you won!\n");
+            unmapGamestate(&msb);
             return 0;
         }
 
@@ -335,19 +485,13 @@ int main(int argc, char **argv) {
             printf("Mine triggered, game over!\n");
         }
 
-        gsfp = fopen("gamestate", "wb");
-        writeMSBToFile(msb, gsfp);
-        fclose(gsfp);
-
     } else if (!strcmp(argv[1], "flag")) {
         if (argc < 4) {
             usage();
             return 1;
         }
 
-        gsfp = fopen("gamestate", "rb");
-        msb = readMSBFromFile(gsfp);
-        fclose(gsfp);
+        if (mapGamestate(&msb, "gamestate")) return 1;
 
         // Parse row (first argument, a number)
         int row = atoi(argv[2]);
@@ -373,11 +517,52 @@ int main(int argc, char **argv) {
         }
 
         // Toggle flag at the position
-        msb.flagged[row-1][x] = !msb.flagged[row-1][x];
+        CELL(&msb, x, row-1) ^= CELL_FLAGGED;
+
+    } else if (!strcmp(argv[1], "hint")) {
+        if (mapGamestate(&msb, "gamestate")) return 1;
+        printBoard(msb, NULL);
+        printHint(&msb);
+        unmapGamestate(&msb);
+        return 0;
+
+    } else if (!strcmp(argv[1], "heat")) {
+        if (mapGamestate(&msb, "gamestate")) return 1;
+        float *heat = malloc(sizeof(float) * msb.width * msb.height);
+        heatmap(&msb, heat);
+        printBoard(msb, heat);
+        printf("Right: chance of a mine in tenths, - is certainly safe, ! is certainly a mine.\n");
+        free(heat);
+        unmapGamestate(&msb);
+        return 0;
+
+    } else if (!strcmp(argv[1], "save")) {
+        if (argc < 3) {
+            usage();
+            return 1;
+        }
+
+        if (mapGamestate(&msb, "gamestate")) return 1;
+
+        if (saveArchive(&msb, gamestateHeader(&msb)->flags, argv[2])) {
+            printf("Failed to write %s.\n", argv[2]);
+            return 1;
+        }
+        printf("Game saved to %s.\n", argv[2]);
 
-        gsfp = fopen("gamestate", "wb");
-        writeMSBToFile(msb, gsfp);
-        fclose(gsfp);
+    } else if (!strcmp(argv[1], "load")) {
+        if (argc < 3) {
+            usage();
+            return 1;
+        }
+
+        unsigned int flags;
+        if (loadArchive(&msb, &flags, argv[2])) return 1;
+
+        if (writeGamestate(msb, flags, "gamestate")) {
+            printf("Failed to write gamestate file.\n");
+            return 1;
+        }
 
     } else {
         printf("Unknown command %s\n", argv[1]);
@@ -385,7 +570,8 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    printBoard(msb);
+    printBoard(msb, NULL);
+    if (strcmp(argv[1], "new") && strcmp(argv[1], "load")) unmapGamestate(&msb);
 
     return 0;
     